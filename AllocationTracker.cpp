@@ -0,0 +1,224 @@
+#include "AllocationTracker.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace gps {
+
+    static const char* const tagNames[ALLOCATION_TAG_COUNT] = {
+        "untagged", "loader", "textures", "renderer", "simulation"
+    };
+
+    const char* getAllocationTagName(AllocationTag tag) {
+        return tagNames[tag];
+    }
+
+    void printAllocationReport() {
+        if (!isAllocationTrackingEnabled()) {
+            printf("Heap allocations are not tracked in this build (GPS_TRACK_ALLOCATIONS=0)\n");
+            return;
+        }
+        printf("Heap allocations: %u so far\n", (unsigned int)getAllocationCount());
+        printf("  %-12s %12s %12s %10s %10s\n", "tag", "live KB", "peak KB", "live", "count");
+        for (int tag = 0; tag < ALLOCATION_TAG_COUNT; tag++) {
+            AllocationStats stats = getAllocationStats((AllocationTag)tag);
+            printf("  %-12s %12.1f %12.1f %10u %10u\n", tagNames[tag], stats.liveBytes / 1024.0, stats.peakBytes / 1024.0,
+                (unsigned int)stats.liveCount, (unsigned int)stats.count);
+        }
+    }
+}
+
+#if GPS_TRACK_ALLOCATIONS
+
+namespace gps {
+
+    struct TagCounters {
+        std::atomic<size_t> liveBytes;
+        std::atomic<size_t> peakBytes;
+        std::atomic<size_t> liveCount;
+        std::atomic<size_t> count;
+    };
+
+    // in front of every block, as large as the strictest fundamental alignment so the block keeps it
+    struct AllocationHeader {
+        size_t size;
+        AllocationTag tag;
+    };
+    static const size_t HEADER_SIZE = 16;
+    static_assert(sizeof(AllocationHeader) <= HEADER_SIZE, "the header has to fit in front of the block");
+
+    // static storage is zeroed before any constructor runs, so allocations of other globals are counted
+    static TagCounters counters[ALLOCATION_TAG_COUNT];
+    static std::atomic<size_t> totalCount;
+    static thread_local size_t threadCount = 0;
+    static thread_local AllocationTag currentTag = ALLOCATION_UNTAGGED;
+
+    static void* allocate(size_t size) {
+        unsigned char* block = (unsigned char*)malloc(size + HEADER_SIZE);
+        if (!block)
+            return NULL;
+
+        AllocationHeader* header = (AllocationHeader*)block;
+        header->size = size;
+        header->tag = currentTag;
+
+        TagCounters& tag = counters[currentTag];
+        size_t live = tag.liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+        size_t peak = tag.peakBytes.load(std::memory_order_relaxed);
+        while (live > peak && !tag.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+        }
+        tag.liveCount.fetch_add(1, std::memory_order_relaxed);
+        tag.count.fetch_add(1, std::memory_order_relaxed);
+        totalCount.fetch_add(1, std::memory_order_relaxed);
+        threadCount++;
+        return block + HEADER_SIZE;
+    }
+
+    static void release(void* block) {
+        if (!block)
+            return;
+        AllocationHeader* header = (AllocationHeader*)((unsigned char*)block - HEADER_SIZE);
+        TagCounters& tag = counters[header->tag];
+        tag.liveBytes.fetch_sub(header->size, std::memory_order_relaxed);
+        tag.liveCount.fetch_sub(1, std::memory_order_relaxed);
+        free(header);
+    }
+
+    bool isAllocationTrackingEnabled() {
+        return true;
+    }
+
+    AllocationStats getAllocationStats(AllocationTag tag) {
+        AllocationStats stats;
+        stats.liveBytes = counters[tag].liveBytes.load(std::memory_order_relaxed);
+        stats.peakBytes = counters[tag].peakBytes.load(std::memory_order_relaxed);
+        stats.liveCount = counters[tag].liveCount.load(std::memory_order_relaxed);
+        stats.count = counters[tag].count.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    size_t getAllocationCount() {
+        return totalCount.load(std::memory_order_relaxed);
+    }
+
+    size_t getThreadAllocationCount() {
+        return threadCount;
+    }
+
+    void* trackedMalloc(size_t size) {
+        return allocate(size);
+    }
+
+    void* trackedRealloc(void* block, size_t size) {
+        if (!block)
+            return allocate(size);
+        if (size == 0) {
+            release(block);
+            return NULL;
+        }
+        // a new block keeps the counts of the old tag and the new one right
+        void* bigger = allocate(size);
+        if (!bigger)
+            return NULL;
+        size_t oldSize = ((AllocationHeader*)((unsigned char*)block - HEADER_SIZE))->size;
+        memcpy(bigger, block, oldSize < size ? oldSize : size);
+        release(block);
+        return bigger;
+    }
+
+    void trackedFree(void* block) {
+        release(block);
+    }
+
+    AllocationScope::AllocationScope(AllocationTag tag) : previous(currentTag) {
+        currentTag = tag;
+    }
+
+    AllocationScope::~AllocationScope() {
+        currentTag = previous;
+    }
+}
+
+static void* allocateOrThrow(size_t size) {
+    for (;;) {
+        void* block = gps::trackedMalloc(size > 0 ? size : 1);
+        if (block)
+            return block;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler)
+            throw std::bad_alloc();
+        handler();
+    }
+}
+
+void* operator new(size_t size) {
+    return allocateOrThrow(size);
+}
+
+void* operator new[](size_t size) {
+    return allocateOrThrow(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return allocateOrThrow(size);
+    }
+    catch (...) {
+        return NULL;
+    }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return allocateOrThrow(size);
+    }
+    catch (...) {
+        return NULL;
+    }
+}
+
+void operator delete(void* block) noexcept {
+    gps::trackedFree(block);
+}
+
+void operator delete[](void* block) noexcept {
+    gps::trackedFree(block);
+}
+
+void operator delete(void* block, size_t) noexcept {
+    gps::trackedFree(block);
+}
+
+void operator delete[](void* block, size_t) noexcept {
+    gps::trackedFree(block);
+}
+
+void operator delete(void* block, const std::nothrow_t&) noexcept {
+    gps::trackedFree(block);
+}
+
+void operator delete[](void* block, const std::nothrow_t&) noexcept {
+    gps::trackedFree(block);
+}
+
+#else
+
+namespace gps {
+
+    bool isAllocationTrackingEnabled() { return false; }
+    AllocationStats getAllocationStats(AllocationTag) { return AllocationStats(); }
+    size_t getAllocationCount() { return 0; }
+    size_t getThreadAllocationCount() { return 0; }
+
+    void* trackedMalloc(size_t size) { return malloc(size); }
+    void* trackedRealloc(void* block, size_t size) { return realloc(block, size); }
+    void trackedFree(void* block) { free(block); }
+
+    AllocationScope::AllocationScope(AllocationTag tag) : previous(tag) {}
+    AllocationScope::~AllocationScope() {}
+}
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef AllocationTracker_hpp
+#define AllocationTracker_hpp
+
+#include <cstddef>
+
+// Heap allocations are tracked in debug builds, or in any build compiled with GPS_TRACK_ALLOCATIONS=1
+#ifndef GPS_TRACK_ALLOCATIONS
+#ifdef _DEBUG
+#define GPS_TRACK_ALLOCATIONS 1
+#else
+#define GPS_TRACK_ALLOCATIONS 0
+#endif
+#endif
+
+namespace gps {
+
+    enum AllocationTag {
+        ALLOCATION_UNTAGGED,
+        // model files, their parsing and the meshes built from them
+        ALLOCATION_LOADER,
+        // image decoding
+        ALLOCATION_TEXTURES,
+        ALLOCATION_RENDERER,
+        ALLOCATION_SIMULATION,
+        ALLOCATION_TAG_COUNT
+    };
+
+    struct AllocationStats {
+        size_t liveBytes;
+        size_t peakBytes;
+        size_t liveCount;
+        // allocations made since the start
+        size_t count;
+    };
+
+    // Heap allocation tracker
+    //
+    // The global operator new and delete are replaced, and stb_image allocates through
+    // trackedMalloc(), so every allocation of the program passes through here. Each one carries
+    // a small header with its size and the tag of the innermost AllocationScope of the thread
+    // that made it, and is counted against that tag until it is freed, whatever thread frees it.
+    // Counting is a few relaxed atomics per allocation. Without GPS_TRACK_ALLOCATIONS nothing is
+    // replaced, the functions return zeros and the scopes do nothing.
+
+    bool isAllocationTrackingEnabled();
+
+    AllocationStats getAllocationStats(AllocationTag tag);
+    const char* getAllocationTagName(AllocationTag tag);
+    // allocations made since the start by all threads and by the calling thread; a frame's
+    // count is the difference of two readings
+    size_t getAllocationCount();
+    size_t getThreadAllocationCount();
+
+    // live, peak and count of every tag
+    void printAllocationReport();
+
+    // malloc, realloc and free for C code, tracked like operator new
+    void* trackedMalloc(size_t size);
+    void* trackedRealloc(void* block, size_t size);
+    void trackedFree(void* block);
+
+    // Tags the allocations of the calling thread while it exists
+    class AllocationScope
+    {
+    public:
+        explicit AllocationScope(AllocationTag tag);
+        ~AllocationScope();
+
+        AllocationScope(const AllocationScope&) = delete;
+        AllocationScope& operator=(const AllocationScope&) = delete;
+
+    private:
+        AllocationTag previous;
+    };
+}
+
+#endif /* AllocationTracker_hpp */
@@ -0,0 +1,252 @@
+#include "Benchmarks.hpp"
+#include "FrustumCulling.hpp"
+#include "OcclusionCulling.hpp"
+#include "JobSystem.hpp"
+
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace gps {
+
+    FrameTimePercentiles computePercentiles(std::vector<double> samples) {
+        FrameTimePercentiles percentiles = FrameTimePercentiles();
+        if (samples.empty())
+            return percentiles;
+
+        std::sort(samples.begin(), samples.end());
+        double total = 0.0;
+        for (size_t i = 0; i < samples.size(); i++)
+            total += samples[i];
+
+        // the smallest sample that at least p percent of the samples don't exceed
+        size_t count = samples.size();
+        percentiles.p50 = samples[(count * 50 + 99) / 100 - 1];
+        percentiles.p95 = samples[(count * 95 + 99) / 100 - 1];
+        percentiles.p99 = samples[(count * 99 + 99) / 100 - 1];
+        percentiles.max = samples[count - 1];
+        percentiles.mean = total / count;
+        return percentiles;
+    }
+
+    // runs cull a number of times and returns the best time of a run, in ms
+    template <typename CullFunction>
+    static double timeCulling(CullFunction cull, const Frustum& frustum, const BoundsSoA& bounds,
+                              std::vector<uint32_t>& visible, int runs) {
+        double best = 1.0e30;
+        for (int i = 0; i < runs; i++) {
+            std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+            cull(frustum, bounds, visible);
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+            if (elapsed.count() < best)
+                best = elapsed.count();
+        }
+        return best;
+    }
+
+    void runCullingBenchmark() {
+        const size_t boxCount = 100000;
+        const int runs = 50;
+
+        // boxes spread all around the camera, only the ones in front of it are visible
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+        std::uniform_real_distribution<float> size(0.1f, 2.0f);
+
+        BoundsSoA bounds;
+        bounds.resize(boxCount);
+        for (size_t i = 0; i < boxCount; i++) {
+            bounds.set(i, glm::vec3(position(random), position(random), position(random)),
+                       glm::vec3(size(random), size(random), size(random)));
+        }
+
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        Frustum frustum = extractFrustum(projection * view);
+
+        std::vector<uint32_t> scalarVisible, simdVisible;
+        scalarVisible.reserve(boxCount);
+        simdVisible.reserve(boxCount);
+
+        double scalarTime = timeCulling(cullBoundsScalar, frustum, bounds, scalarVisible, runs);
+        double simdTime = timeCulling(cullBounds, frustum, bounds, simdVisible, runs);
+
+        printf("Frustum culling (%u boxes, best of %d runs)\n", (unsigned int)boxCount, runs);
+        printf("  visible : %u\n", (unsigned int)simdVisible.size());
+        printf("  scalar  : %.3f ms (%.2f ns/box)\n", scalarTime, scalarTime * 1.0e6 / boxCount);
+        printf("  simd    : %.3f ms (%.2f ns/box)\n", simdTime, simdTime * 1.0e6 / boxCount);
+        printf("  speedup : %.2fx\n", scalarTime / simdTime);
+        if (scalarVisible != simdVisible)
+            printf("  WARNING: scalar and simd results differ\n");
+    }
+
+    // best time of a number of occlusion renders, in ms
+    static double timeOcclusionRender(OcclusionCuller& culler, const glm::mat4& viewProjection, int runs) {
+        double best = 1.0e30;
+        for (int i = 0; i < runs; i++) {
+            std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+            culler.render(viewProjection);
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+            if (elapsed.count() < best)
+                best = elapsed.count();
+        }
+        return best;
+    }
+
+    void runOcclusionBenchmark() {
+        const int gridSize = 64;
+        const float wallDistance = 10.0f;
+        const size_t boxCount = 10000;
+        const int runs = 50;
+
+        // a 20x20 wall across the view, split in gridSize x gridSize quads
+        std::vector<glm::vec3> positions;
+        std::vector<uint32_t> indices;
+        for (int y = 0; y <= gridSize; y++) {
+            for (int x = 0; x <= gridSize; x++)
+                positions.push_back(glm::vec3(-10.0f + 20.0f * x / gridSize, -10.0f + 20.0f * y / gridSize, -wallDistance));
+        }
+        for (int y = 0; y < gridSize; y++) {
+            for (int x = 0; x < gridSize; x++) {
+                uint32_t corner = y * (gridSize + 1) + x;
+                uint32_t quad[6] = { corner, corner + 1, corner + gridSize + 2, corner, corner + gridSize + 2, corner + gridSize + 1 };
+                indices.insert(indices.end(), quad, quad + 6);
+            }
+        }
+
+        OcclusionCuller culler;
+        culler.addOccluder(positions, indices, glm::mat4(1.0f));
+
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 viewProjection = projection * view;
+
+        culler.setJobSystem(NULL);
+        double singleTime = timeOcclusionRender(culler, viewProjection, runs);
+        JobSystem jobs;
+        jobs.start(0);
+        unsigned int threads = jobs.getThreadCount();
+        culler.setJobSystem(&jobs);
+        double threadedTime = timeOcclusionRender(culler, viewProjection, runs);
+
+        // boxes in front of and behind the wall, inside the view
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<float> side(-1.5f, 1.5f);
+        std::uniform_real_distribution<float> depth(-30.0f, -2.0f);
+        std::uniform_real_distribution<float> size(0.05f, 0.5f);
+
+        BoundsSoA bounds;
+        bounds.resize(boxCount);
+        std::vector<uint32_t> visible(boxCount);
+        for (size_t i = 0; i < boxCount; i++) {
+            bounds.set(i, glm::vec3(side(random), side(random), depth(random)), glm::vec3(size(random)));
+            visible[i] = (uint32_t)i;
+        }
+
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        size_t occluded = culler.cull(bounds, visible);
+        std::chrono::duration<double, std::milli> testTime = std::chrono::high_resolution_clock::now() - start;
+
+        size_t behind = 0, wrong = 0, next = 0;
+        for (size_t i = 0; i < boxCount; i++) {
+            bool isBehind = bounds.centerZ[i] + bounds.extentZ[i] < -wallDistance;
+            bool isVisible = next < visible.size() && visible[next] == i;
+            if (isVisible)
+                next++;
+            if (isBehind)
+                behind++;
+            else if (!isVisible)
+                wrong++;
+        }
+
+        printf("Occlusion culling (%dx%d buffer, %u occluder triangles, best of %d runs)\n",
+            culler.getWidth(), culler.getHeight(), (unsigned int)culler.getTriangleCount(), runs);
+        printf("  render, 1 thread   : %.3f ms\n", singleTime);
+        printf("  render, %2u threads : %.3f ms\n", threads, threadedTime);
+        printf("  test %u boxes    : %.3f ms, %u of %u boxes behind the wall occluded\n",
+            (unsigned int)boxCount, testTime.count(), (unsigned int)occluded, (unsigned int)behind);
+        if (wrong != 0)
+            printf("  WARNING: %u boxes in front of the wall were occluded\n", (unsigned int)wrong);
+    }
+
+    // queues jobCount empty jobs and waits for them, returns the best time of a run in ms
+    static double timeEmptyJobs(JobSystem& jobs, size_t jobCount, int runs) {
+        double best = 1.0e30;
+        for (int i = 0; i < runs; i++) {
+            std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+            JobCounter counter;
+            for (size_t j = 0; j < jobCount; j++)
+                jobs.run("empty", []() {}, counter);
+            jobs.wait(counter);
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+            if (elapsed.count() < best)
+                best = elapsed.count();
+        }
+        return best;
+    }
+
+    // parallel_for over a math heavy loop, returns the best time of a run in ms
+    static double timeParallelFor(JobSystem& jobs, std::vector<float>& values, size_t grainSize, int runs) {
+        double best = 1.0e30;
+        for (int i = 0; i < runs; i++) {
+            std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+            jobs.parallelFor("bench", values.size(), grainSize, [&values](size_t begin, size_t end) {
+                for (size_t j = begin; j < end; j++) {
+                    float x = (float)j;
+                    for (int k = 0; k < 16; k++)
+                        x = std::sqrt(x * 1.0001f + 1.0f);
+                    values[j] = x;
+                }
+            });
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+            if (elapsed.count() < best)
+                best = elapsed.count();
+        }
+        return best;
+    }
+
+    void runJobBenchmark() {
+        const size_t jobCount = 100000;
+        const size_t itemCount = 1 << 21;
+        const size_t grainSize = 4096;
+        const int runs = 10;
+
+        unsigned int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<float> values(itemCount);
+
+        printf("Job system (%u empty jobs, parallel_for over %u items in chunks of %u, best of %d runs)\n",
+            (unsigned int)jobCount, (unsigned int)itemCount, (unsigned int)grainSize, runs);
+        printf("  threads | empty job | parallel_for | speedup | stolen\n");
+
+        // 1, 2, 4... and all the hardware threads
+        std::vector<unsigned int> threadCounts;
+        for (unsigned int threads = 1; threads < maxThreads; threads *= 2)
+            threadCounts.push_back(threads);
+        threadCounts.push_back(maxThreads);
+
+        double baseTime = 0.0;
+        for (size_t i = 0; i < threadCounts.size(); i++) {
+            unsigned int threads = threadCounts[i];
+            // without workers the jobs run on this thread
+            JobSystem jobs;
+            if (threads > 1)
+                jobs.start(threads - 1);
+
+            double emptyTime = timeEmptyJobs(jobs, jobCount, runs);
+            jobs.resetStats();
+            double forTime = timeParallelFor(jobs, values, grainSize, runs);
+            JobStats stats = jobs.getStats();
+            if (threads == 1)
+                baseTime = forTime;
+
+            printf("  %7u | %6.1f ns | %9.3f ms | %6.2fx | %5.1f%%\n", threads, emptyTime * 1.0e6 / jobCount,
+                forTime, baseTime / forTime, stats.executed != 0 ? 100.0 * stats.stolen / stats.executed : 0.0);
+        }
+    }
+}
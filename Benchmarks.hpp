@@ -0,0 +1,34 @@
+#ifndef Benchmarks_hpp
+#define Benchmarks_hpp
+
+#include <vector>
+
+namespace gps {
+
+    // Summary of a series of frame times, in ms
+    struct FrameTimePercentiles {
+        double p50;
+        double p95;
+        double p99;
+        double max;
+        double mean;
+    };
+
+    // Nearest rank percentiles of samples, all zero when there are none
+    FrameTimePercentiles computePercentiles(std::vector<double> samples);
+
+    // CPU side microbenchmarks, run from the command line without opening a window
+
+    // Culls 100k random boxes with the scalar and the SIMD paths and prints the time per box
+    void runCullingBenchmark();
+
+    // Rasterizes a dense wall occluder and tests 10k boxes around it, single threaded and threaded
+    // Checks that no box in front of the wall is reported as occluded
+    void runOcclusionBenchmark();
+
+    // Measures the cost of queueing and running an empty job and how parallel_for scales from 1 to
+    // all hardware threads
+    void runJobBenchmark();
+}
+
+#endif /* Benchmarks_hpp */
@@ -37,6 +37,27 @@ namespace gps {
 		return cameraTarget;
 	}
 
+	glm::vec3 Camera::getCameraFrontDirection()
+	{
+		return cameraFrontDirection;
+	}
+
+	glm::vec3 Camera::getCameraUpDirection()
+	{
+		return cameraUpDirection;
+	}
+
+	void Camera::setCameraPosition(glm::vec3 position)
+	{
+		cameraPosition = position;
+	}
+
+	void Camera::setCameraFrontDirection(glm::vec3 front)
+	{
+		cameraFrontDirection = glm::normalize(front);
+		cameraRightDirection = glm::normalize(glm::cross(cameraFrontDirection, cameraUpDirection));
+	}
+
     //update the camera internal parameters following a camera move event
     void Camera::move(MOVE_DIRECTION direction, float speed) {
         //-TODO
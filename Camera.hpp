@@ -27,6 +27,11 @@ namespace gps {
 		void displayCameraPosition();
 		void getCameraPosition(float *x, float *y, float *z);
 		glm::vec3 getCameraTarget();
+		glm::vec3 getCameraFrontDirection();
+		glm::vec3 getCameraUpDirection();
+		//place the camera directly, used by the camera path replay
+		void setCameraPosition(glm::vec3 position);
+		void setCameraFrontDirection(glm::vec3 front);
         
     private:
         glm::vec3 cameraPosition;
@@ -0,0 +1,169 @@
+#include "CameraPath.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+
+namespace gps {
+
+    static const char CAMERA_PATH_MAGIC[4] = { 'G', 'P', 'S', 'C' };
+    static const uint32_t CAMERA_PATH_VERSION = 1;
+
+    template <typename T>
+    static void writeValue(std::ofstream& file, T value) {
+        file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    static T readValue(std::ifstream& file) {
+        T value = T();
+        file.read(reinterpret_cast<char*>(&value), sizeof(T));
+        return value;
+    }
+
+    static void writeVec3(std::ofstream& file, const glm::vec3& v) {
+        writeValue(file, v.x);
+        writeValue(file, v.y);
+        writeValue(file, v.z);
+    }
+
+    static glm::vec3 readVec3(std::ifstream& file) {
+        glm::vec3 v;
+        v.x = readValue<float>(file);
+        v.y = readValue<float>(file);
+        v.z = readValue<float>(file);
+        return v;
+    }
+
+    static glm::vec3 catmullRom(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float t) {
+        float t2 = t * t;
+        float t3 = t2 * t;
+        return 0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 +
+                       (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+    }
+
+    void CameraPath::clear() {
+        keyframes.clear();
+        events.clear();
+    }
+
+    void CameraPath::addKeyframe(double time, const glm::vec3& position, const glm::vec3& front) {
+        CameraKeyframe keyframe;
+        keyframe.time = time;
+        keyframe.position = position;
+        keyframe.front = front;
+        keyframes.push_back(keyframe);
+    }
+
+    void CameraPath::addKeyEvent(double time, int key, int action) {
+        CameraInputEvent event = CameraInputEvent();
+        event.time = time;
+        event.type = CAMERA_INPUT_KEY;
+        event.key = key;
+        event.action = action;
+        events.push_back(event);
+    }
+
+    bool CameraPath::save(const std::string& fileName) const {
+        std::ofstream file(fileName.c_str(), std::ios::binary);
+        if (!file) {
+            std::cerr << "Could not write camera path " << fileName << std::endl;
+            return false;
+        }
+
+        file.write(CAMERA_PATH_MAGIC, sizeof(CAMERA_PATH_MAGIC));
+        writeValue(file, CAMERA_PATH_VERSION);
+        writeValue(file, (uint32_t)keyframes.size());
+        writeValue(file, (uint32_t)events.size());
+
+        for (size_t i = 0; i < keyframes.size(); i++) {
+            writeValue(file, keyframes[i].time);
+            writeVec3(file, keyframes[i].position);
+            writeVec3(file, keyframes[i].front);
+        }
+
+        // key events don't use x and y and mouse events don't use key and action, but a fixed size
+        // keeps the file trivial to read
+        for (size_t i = 0; i < events.size(); i++) {
+            writeValue(file, events[i].time);
+            writeValue(file, (uint8_t)events[i].type);
+            writeValue(file, (uint8_t)events[i].action);
+            writeValue(file, (uint16_t)events[i].key);
+            writeValue(file, events[i].x);
+            writeValue(file, events[i].y);
+        }
+        return true;
+    }
+
+    bool CameraPath::load(const std::string& fileName) {
+        clear();
+        std::ifstream file(fileName.c_str(), std::ios::binary);
+        char magic[4] = {};
+        file.read(magic, sizeof(magic));
+        if (!file || !std::equal(magic, magic + 4, CAMERA_PATH_MAGIC) || readValue<uint32_t>(file) != CAMERA_PATH_VERSION) {
+            std::cerr << "Not a camera path: " << fileName << std::endl;
+            return false;
+        }
+
+        uint32_t keyframeCount = readValue<uint32_t>(file);
+        uint32_t eventCount = readValue<uint32_t>(file);
+        for (uint32_t i = 0; i < keyframeCount && file; i++) {
+            CameraKeyframe keyframe;
+            keyframe.time = readValue<double>(file);
+            keyframe.position = readVec3(file);
+            keyframe.front = readVec3(file);
+            keyframes.push_back(keyframe);
+        }
+        for (uint32_t i = 0; i < eventCount && file; i++) {
+            CameraInputEvent event;
+            event.time = readValue<double>(file);
+            event.type = (CameraInputType)readValue<uint8_t>(file);
+            event.action = readValue<uint8_t>(file);
+            event.key = readValue<uint16_t>(file);
+            event.x = readValue<float>(file);
+            event.y = readValue<float>(file);
+            events.push_back(event);
+        }
+
+        if (!file) {
+            std::cerr << "Camera path is truncated: " << fileName << std::endl;
+            clear();
+            return false;
+        }
+        return true;
+    }
+
+    double CameraPath::getDuration() const {
+        return keyframes.empty() ? 0.0 : keyframes.back().time;
+    }
+
+    void CameraPath::sample(double time, glm::vec3& position, glm::vec3& front) const {
+        if (keyframes.empty())
+            return;
+        if (time <= keyframes.front().time || keyframes.size() == 1) {
+            position = keyframes.front().position;
+            front = keyframes.front().front;
+            return;
+        }
+        if (time >= keyframes.back().time) {
+            position = keyframes.back().position;
+            front = keyframes.back().front;
+            return;
+        }
+
+        // segment [i, i + 1] contains time, its neighbours shape the curve and repeat at the ends
+        struct KeyframeTime {
+            bool operator()(double t, const CameraKeyframe& keyframe) const { return t < keyframe.time; }
+        };
+        size_t i = std::upper_bound(keyframes.begin(), keyframes.end(), time, KeyframeTime()) - keyframes.begin() - 1;
+        const CameraKeyframe& k0 = keyframes[i > 0 ? i - 1 : i];
+        const CameraKeyframe& k1 = keyframes[i];
+        const CameraKeyframe& k2 = keyframes[i + 1];
+        const CameraKeyframe& k3 = keyframes[i + 2 < keyframes.size() ? i + 2 : i + 1];
+        float t = (float)((time - k1.time) / (k2.time - k1.time));
+
+        position = catmullRom(k0.position, k1.position, k2.position, k3.position, t);
+        front = glm::normalize(catmullRom(k0.front, k1.front, k2.front, k3.front, t));
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef CameraPath_hpp
+#define CameraPath_hpp
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    // Camera state at one moment of a recording, time in seconds from its start
+    struct CameraKeyframe {
+        double time;
+        glm::vec3 position;
+        glm::vec3 front;
+    };
+
+    enum CameraInputType { CAMERA_INPUT_KEY, CAMERA_INPUT_MOUSE };
+
+    // A key press/release (key, action) as the simulation step it changed on saw it
+    // Cursor moves (x, y) are part of the file format but not recorded, the keyframes carry the camera
+    struct CameraInputEvent {
+        double time;
+        CameraInputType type;
+        int key;
+        int action;
+        float x, y;
+    };
+
+    // A recorded camera flight: keyframes of the camera plus the key events of the scene controls
+    //
+    // Both are stamped with the simulation time of the step that produced them, so a replay applies
+    // every key change on the step it was recorded on. Replay goes through sample(), a Catmull-Rom
+    // spline through the keyframes, so it only depends on the time asked for and not on the frame rate.
+    //
+    // The file is little endian binary: "GPSC", version, keyframe count and event count as uint32,
+    // then 32 bytes per keyframe and 20 per event.
+    class CameraPath
+    {
+    public:
+        void clear();
+
+        void addKeyframe(double time, const glm::vec3& position, const glm::vec3& front);
+        void addKeyEvent(double time, int key, int action);
+
+        // Both print the reason and return false when the file can't be used
+        bool save(const std::string& fileName) const;
+        bool load(const std::string& fileName);
+
+        bool empty() const { return keyframes.empty(); }
+        // time of the last keyframe
+        double getDuration() const;
+        // events sorted by time
+        const std::vector<CameraInputEvent>& getEvents() const { return events; }
+
+        // Camera at time, clamped to the first and last keyframe
+        void sample(double time, glm::vec3& position, glm::vec3& front) const;
+
+    private:
+        std::vector<CameraKeyframe> keyframes;
+        std::vector<CameraInputEvent> events;
+    };
+}
+
+#endif /* CameraPath_hpp */
@@ -0,0 +1,140 @@
+#include "CpuProfiler.hpp"
+
+#include <iostream>
+
+#if GPS_PROFILE
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+#endif
+
+namespace gps {
+
+#if GPS_PROFILE
+
+    static const size_t ZONE_CAPACITY = 1 << 16;
+    static const int MAX_ZONE_DEPTH = 64;
+
+    struct ProfileEvent {
+        const char* name;
+        long long begin;
+        long long end;
+    };
+
+    // zones of one thread, only that thread writes it
+    struct ThreadZones {
+        unsigned int id;
+        const char* name;
+        std::vector<ProfileEvent> events;
+        // zones recorded so far, the ring holds the last ZONE_CAPACITY of them
+        size_t written;
+
+        const char* openNames[MAX_ZONE_DEPTH];
+        long long openBegins[MAX_ZONE_DEPTH];
+        int depth;
+    };
+
+    // buffers outlive their threads, so a trace can be written after the threads are joined
+    static std::mutex threadsMutex;
+    static std::vector<std::unique_ptr<ThreadZones> > threads;
+    static const std::chrono::steady_clock::time_point traceStart = std::chrono::steady_clock::now();
+    static thread_local ThreadZones* currentZones = NULL;
+
+    static long long now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - traceStart).count();
+    }
+
+    // the lock is only taken the first time a thread records
+    static ThreadZones& getThreadZones() {
+        if (currentZones == NULL) {
+            std::unique_ptr<ThreadZones> zones(new ThreadZones());
+            zones->name = NULL;
+            zones->events.resize(ZONE_CAPACITY);
+            zones->written = 0;
+            zones->depth = 0;
+
+            std::lock_guard<std::mutex> lock(threadsMutex);
+            zones->id = (unsigned int)threads.size();
+            currentZones = zones.get();
+            threads.push_back(std::move(zones));
+        }
+        return *currentZones;
+    }
+
+    void setProfileThreadName(const char* name) {
+        getThreadZones().name = name;
+    }
+
+    void beginProfileZone(const char* name) {
+        ThreadZones& zones = getThreadZones();
+        // deeper zones are dropped, but still have to balance their end
+        if (zones.depth < MAX_ZONE_DEPTH) {
+            zones.openNames[zones.depth] = name;
+            zones.openBegins[zones.depth] = now();
+        }
+        zones.depth++;
+    }
+
+    void endProfileZone() {
+        ThreadZones& zones = getThreadZones();
+        if (zones.depth == 0)
+            return;
+        zones.depth--;
+        if (zones.depth >= MAX_ZONE_DEPTH)
+            return;
+
+        ProfileEvent& event = zones.events[zones.written % ZONE_CAPACITY];
+        event.name = zones.openNames[zones.depth];
+        event.begin = zones.openBegins[zones.depth];
+        event.end = now();
+        zones.written++;
+    }
+
+    bool writeChromeTrace(const std::string& fileName) {
+        FILE* file = fopen(fileName.c_str(), "w");
+        if (!file) {
+            std::cerr << "Could not write trace " << fileName << std::endl;
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        bool first = true;
+        for (size_t t = 0; t < threads.size(); t++) {
+            const ThreadZones& zones = *threads[t];
+            if (zones.name)
+                fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                    first ? "" : ",\n", zones.id, zones.name);
+            else
+                fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}",
+                    first ? "" : ",\n", zones.id, zones.id);
+            first = false;
+
+            // complete events, in microseconds
+            size_t count = zones.written < ZONE_CAPACITY ? zones.written : ZONE_CAPACITY;
+            for (size_t i = zones.written - count; i < zones.written; i++) {
+                const ProfileEvent& event = zones.events[i % ZONE_CAPACITY];
+                fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    event.name, zones.id, event.begin / 1000.0, (event.end - event.begin) / 1000.0);
+            }
+        }
+        fprintf(file, "\n]}\n");
+        fclose(file);
+        return true;
+    }
+
+#else
+
+    void setProfileThreadName(const char*) {}
+    void beginProfileZone(const char*) {}
+    void endProfileZone() {}
+
+    bool writeChromeTrace(const std::string& fileName) {
+        std::cerr << "Not writing " << fileName << ", profiling zones are compiled out (build with GPS_PROFILE=1)" << std::endl;
+        return false;
+    }
+
+#endif
+}
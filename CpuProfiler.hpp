@@ -0,0 +1,55 @@
+#ifndef CpuProfiler_hpp
+#define CpuProfiler_hpp
+
+#include <string>
+
+// Zones are recorded in debug builds, or in any build compiled with GPS_PROFILE=1
+#ifndef GPS_PROFILE
+#ifdef _DEBUG
+#define GPS_PROFILE 1
+#else
+#define GPS_PROFILE 0
+#endif
+#endif
+
+namespace gps {
+
+    // CPU profiling zones, exported as Chrome trace events (chrome://tracing, ui.perfetto.dev)
+    //
+    // Every thread records its zones in its own ring buffer of the last ZONE_CAPACITY zones, with
+    // steady_clock timestamps taken when a zone opens and closes. Recording takes no lock, so
+    // the buffers may only be exported while no thread records, e.g. once the workers are idle.
+    // Without GPS_PROFILE the zones compile to nothing and the functions do nothing.
+
+    // Name of the calling thread in the trace, a literal; unnamed threads are "thread N"
+    void setProfileThreadName(const char* name);
+
+    // name must be a literal, zones close in the reverse order they opened
+    void beginProfileZone(const char* name);
+    void endProfileZone();
+
+    // Prints the reason and returns false when the file can't be written or zones are compiled out
+    bool writeChromeTrace(const std::string& fileName);
+
+    // Records a zone from its construction to its destruction
+    class ProfileZone
+    {
+    public:
+        explicit ProfileZone(const char* name) { beginProfileZone(name); }
+        ~ProfileZone() { endProfileZone(); }
+
+        ProfileZone(const ProfileZone&) = delete;
+        ProfileZone& operator=(const ProfileZone&) = delete;
+    };
+}
+
+#if GPS_PROFILE
+#define GPS_PROFILE_CONCAT_(a, b) a##b
+#define GPS_PROFILE_CONCAT(a, b) GPS_PROFILE_CONCAT_(a, b)
+// Profiles the rest of the enclosing block
+#define GPS_PROFILE_ZONE(name) gps::ProfileZone GPS_PROFILE_CONCAT(profileZone, __LINE__)(name)
+#else
+#define GPS_PROFILE_ZONE(name) ((void)0)
+#endif
+
+#endif /* CpuProfiler_hpp */
@@ -0,0 +1,108 @@
+#include "FlightRecorder.hpp"
+
+#include <cstdio>
+#include <iostream>
+
+namespace gps {
+
+    FlightRecorder::FlightRecorder()
+        : frames(CAPACITY), recorded(0), budget(1000.0f / 30.0f), outputPrefix("hitch_"),
+          hitchCount(0), dumpPending(false), dumpHitch(0), dumpLast(0) {
+    }
+
+    void FlightRecorder::setBudget(float budget) {
+        this->budget = budget;
+    }
+
+    float FlightRecorder::getBudget() const {
+        return budget;
+    }
+
+    void FlightRecorder::setOutputPrefix(const std::string& prefix) {
+        outputPrefix = prefix;
+    }
+
+    void FlightRecorder::record(const FlightFrame& frame) {
+        frames[recorded % CAPACITY] = frame;
+        recorded++;
+        if (budget <= 0.0f)
+            return;
+
+        if (recorded > WARMUP_FRAMES && frame.frameTime > budget) {
+            hitchCount++;
+            if (!dumpPending) {
+                dumpPending = true;
+                dumpHitch = frame.frame;
+            }
+            dumpLast = frame.frame + FRAMES_AFTER;
+        }
+
+        if (dumpPending && frame.frame >= dumpLast) {
+            char fileName[32];
+            snprintf(fileName, sizeof(fileName), "%u.json", dumpHitch);
+            unsigned int first = dumpHitch > FRAMES_BEFORE ? dumpHitch - FRAMES_BEFORE : 0;
+            if (dump(outputPrefix + fileName, first, dumpLast))
+                std::cout << "Frame " << dumpHitch << " took over " << budget << " ms, wrote " << outputPrefix << fileName << std::endl;
+            dumpPending = false;
+        }
+    }
+
+    size_t FlightRecorder::findSlot(unsigned int frame) const {
+        // frames are recorded in order, the newest one tells where frame would be
+        if (recorded == 0)
+            return CAPACITY;
+        const FlightFrame& newest = frames[(recorded - 1) % CAPACITY];
+        if (frame > newest.frame || newest.frame - frame >= recorded || newest.frame - frame >= CAPACITY)
+            return CAPACITY;
+        size_t slot = (recorded - 1 - (newest.frame - frame)) % CAPACITY;
+        return frames[slot].frame == frame ? slot : CAPACITY;
+    }
+
+    void FlightRecorder::setGpuTime(unsigned int frame, float gpuTime) {
+        size_t slot = findSlot(frame);
+        if (slot != CAPACITY)
+            frames[slot].gpuTime = gpuTime;
+    }
+
+    unsigned int FlightRecorder::getHitchCount() const {
+        return hitchCount;
+    }
+
+    bool FlightRecorder::dump(const std::string& fileName, unsigned int first, unsigned int last) const {
+        FILE* file = fopen(fileName.c_str(), "w");
+        if (!file) {
+            std::cerr << "Could not write flight recording " << fileName << std::endl;
+            return false;
+        }
+
+        // main thread, simulation and GPU each get a track, times in microseconds
+        fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"main\"}},\n");
+        fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"simulation\"}},\n");
+        fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}");
+        for (unsigned int f = first; f <= last; f++) {
+            size_t slot = findSlot(f);
+            if (slot == CAPACITY)
+                continue;
+            const FlightFrame* frame = &frames[slot];
+
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":0,\"ts\":%.1f,\"dur\":%.1f,\"args\":{\"frame\":%u}}",
+                frame->frameTime > budget ? "hitch" : "frame", frame->start * 1.0e6, frame->frameTime * 1.0e3, frame->frame);
+            fprintf(file, ",\n{\"name\":\"simulate\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.1f,\"dur\":%.1f}",
+                frame->simulateStart * 1.0e6, frame->simulateTime * 1.0e3);
+            fprintf(file, ",\n{\"name\":\"render\",\"ph\":\"X\",\"pid\":1,\"tid\":0,\"ts\":%.1f,\"dur\":%.1f}",
+                frame->renderStart * 1.0e6, frame->renderTime * 1.0e3);
+            // the GPU start isn't known, the bar starts with the submit
+            if (frame->gpuTime >= 0.0f)
+                fprintf(file, ",\n{\"name\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":%.1f,\"dur\":%.1f}",
+                    frame->renderStart * 1.0e6, frame->gpuTime * 1.0e3);
+            fprintf(file, ",\n{\"name\":\"draws\",\"ph\":\"C\",\"pid\":1,\"ts\":%.1f,\"args\":{\"draws\":%u,\"calls\":%u}}",
+                frame->start * 1.0e6, frame->draws, frame->drawCalls);
+            fprintf(file, ",\n{\"name\":\"allocations\",\"ph\":\"C\",\"pid\":1,\"ts\":%.1f,\"args\":{\"allocations\":%u}}",
+                frame->start * 1.0e6, frame->allocations);
+        }
+        fprintf(file, "\n]}\n");
+        fclose(file);
+        return true;
+    }
+}
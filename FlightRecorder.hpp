@@ -0,0 +1,76 @@
+#ifndef FlightRecorder_hpp
+#define FlightRecorder_hpp
+
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    // What the flight recorder keeps of a frame, times in seconds since start and durations in ms
+    struct FlightFrame {
+        unsigned int frame;
+        double start;
+        float frameTime;
+        double simulateStart;
+        float simulateTime;
+        double renderStart;
+        float renderTime;
+        // arrives a few frames late from the GPU profiler, negative until then
+        float gpuTime;
+        unsigned int draws;
+        unsigned int drawCalls;
+        // heap allocations of all threads during the frame, 0 unless they are tracked
+        unsigned int allocations;
+    };
+
+    // Always-on recorder of the last CAPACITY frames that dumps the frames around a hitch
+    //
+    // A frame over the budget schedules a dump; it is written FRAMES_AFTER frames later, so the
+    // trace shows what followed and the GPU times of the hitch have come back. Hitches during
+    // that wait go to the same dump. The dump is a Chrome trace (chrome://tracing, Perfetto) of
+    // the FRAMES_BEFORE frames before the hitch and the ones after.
+    // Recording a frame is a copy into the ring, nothing is allocated after construction.
+    class FlightRecorder
+    {
+    public:
+        static const size_t CAPACITY = 600;
+        static const unsigned int FRAMES_BEFORE = 180;
+        static const unsigned int FRAMES_AFTER = 30;
+        // startup frames are slow for reasons of their own
+        static const unsigned int WARMUP_FRAMES = 60;
+
+        FlightRecorder();
+
+        // A frame slower than budget ms is a hitch, 0 turns the recorder off
+        void setBudget(float budget);
+        float getBudget() const;
+        // Dumps go to prefix + frame number + ".json"
+        void setOutputPrefix(const std::string& prefix);
+
+        // Keeps frame, writes the pending dump once its frames are in
+        void record(const FlightFrame& frame);
+        // GPU time of a frame recorded earlier, dropped if it left the ring already
+        void setGpuTime(unsigned int frame, float gpuTime);
+
+        unsigned int getHitchCount() const;
+
+        // Writes the frames [first, last] that are still in the ring
+        bool dump(const std::string& fileName, unsigned int first, unsigned int last) const;
+
+    private:
+        std::vector<FlightFrame> frames;
+        size_t recorded;
+        float budget;
+        std::string outputPrefix;
+        unsigned int hitchCount;
+
+        bool dumpPending;
+        unsigned int dumpHitch;
+        unsigned int dumpLast;
+
+        // slot of frame in the ring, CAPACITY if it isn't there
+        size_t findSlot(unsigned int frame) const;
+    };
+}
+
+#endif /* FlightRecorder_hpp */
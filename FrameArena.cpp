@@ -0,0 +1,98 @@
+#include "FrameArena.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+namespace gps {
+
+    FrameArena::FrameArena() : current(0), offset(0), used(0) {
+    }
+
+    FrameArena::~FrameArena() {
+        for (size_t i = 0; i < blocks.size(); i++)
+            delete[] blocks[i].memory;
+    }
+
+    void* FrameArena::allocate(size_t size, size_t alignment) {
+        // the first block that still fits it, a new one at the end if none does
+        for (; current < blocks.size(); current++, offset = 0) {
+            uintptr_t start = (uintptr_t)blocks[current].memory + offset;
+            size_t padding = (alignment - start % alignment) % alignment;
+            if (offset + padding + size <= blocks[current].size) {
+                offset += padding + size;
+                used += size;
+                return (void*)(start + padding);
+            }
+        }
+
+        // operator new[] returns memory aligned for any fundamental type, larger alignments get room
+        Block block;
+        block.size = size + alignment > BLOCK_SIZE ? size + alignment : BLOCK_SIZE;
+        block.memory = new unsigned char[block.size];
+        blocks.push_back(block);
+        offset = 0;
+        return allocate(size, alignment);
+    }
+
+    void FrameArena::deallocate(void* block, size_t size) {
+        if (current < blocks.size() && (unsigned char*)block + size == blocks[current].memory + offset) {
+            offset -= size;
+            used -= size;
+        }
+    }
+
+    void FrameArena::reset() {
+        current = 0;
+        offset = 0;
+        used = 0;
+    }
+
+    size_t FrameArena::getUsed() const {
+        return used;
+    }
+
+    size_t FrameArena::getCapacity() const {
+        size_t capacity = 0;
+        for (size_t i = 0; i < blocks.size(); i++)
+            capacity += blocks[i].size;
+        return capacity;
+    }
+
+    struct ThreadArenas {
+        FrameArena slots[FRAME_ARENA_SLOTS];
+    };
+
+    // arenas outlive their threads, a job thread that ends leaves them to the next reset
+    static std::mutex threadsMutex;
+    static std::vector<std::unique_ptr<ThreadArenas> > threads;
+    static thread_local ThreadArenas* currentArenas = NULL;
+    static thread_local int currentSlot = -1;
+
+    void resetFrameArenas(unsigned int frame) {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        for (size_t i = 0; i < threads.size(); i++)
+            threads[i]->slots[frame % FRAME_ARENA_SLOTS].reset();
+    }
+
+    // the lock is only taken the first time a thread allocates
+    FrameArena* getFrameArena() {
+        if (currentSlot < 0)
+            return NULL;
+        if (currentArenas == NULL) {
+            std::unique_ptr<ThreadArenas> arenas(new ThreadArenas());
+            std::lock_guard<std::mutex> lock(threadsMutex);
+            currentArenas = arenas.get();
+            threads.push_back(std::move(arenas));
+        }
+        return &currentArenas->slots[currentSlot];
+    }
+
+    FrameAllocationScope::FrameAllocationScope(unsigned int frame) : previous(currentSlot) {
+        currentSlot = (int)(frame % FRAME_ARENA_SLOTS);
+    }
+
+    FrameAllocationScope::~FrameAllocationScope() {
+        currentSlot = previous;
+    }
+}
@@ -0,0 +1,123 @@
+#ifndef FrameArena_hpp
+#define FrameArena_hpp
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace gps {
+
+    // Frames whose transient data can be alive at once, a frame's memory is reused this many frames later
+    static const unsigned int FRAME_ARENA_SLOTS = 3;
+
+    // Bump allocator over blocks that are kept between resets
+    //
+    // An allocation moves a pointer, a reset makes all of it free again. Blocks are only
+    // allocated until the arena has seen its largest frame, after that it never touches the heap.
+    // Not thread safe, every thread has its own arenas (see getFrameArena()).
+    class FrameArena
+    {
+    public:
+        static const size_t BLOCK_SIZE = 256 * 1024;
+
+        FrameArena();
+        ~FrameArena();
+
+        FrameArena(const FrameArena&) = delete;
+        FrameArena& operator=(const FrameArena&) = delete;
+
+        // alignment is a power of two
+        void* allocate(size_t size, size_t alignment);
+        // Only the newest allocation is given back, anything else waits for the reset
+        void deallocate(void* block, size_t size);
+        void reset();
+
+        // bytes handed out since the reset and bytes held in blocks
+        size_t getUsed() const;
+        size_t getCapacity() const;
+
+    private:
+        struct Block {
+            unsigned char* memory;
+            size_t size;
+        };
+
+        std::vector<Block> blocks;
+        size_t current;
+        size_t offset;
+        size_t used;
+    };
+
+    // Per-thread frame arenas
+    //
+    // Each thread has FRAME_ARENA_SLOTS arenas, frame N allocates from slot N % FRAME_ARENA_SLOTS.
+    // resetFrameArenas(N) frees the slot of frame N on every thread, so the data of frame
+    // N - FRAME_ARENA_SLOTS must be dead by then. Threads pick the frame they allocate for with a
+    // FrameAllocationScope. A scope only covers the thread that opened it, so job system workers
+    // have none and their FrameAllocators use the heap.
+
+    // Frees the memory of the slot of frame on all threads, call it before anything allocates for frame
+    void resetFrameArenas(unsigned int frame);
+    // the calling thread's arena for the frame of its innermost scope, NULL outside any scope
+    FrameArena* getFrameArena();
+
+    // Allocations of the calling thread go to the arena of frame while it exists
+    class FrameAllocationScope
+    {
+    public:
+        explicit FrameAllocationScope(unsigned int frame);
+        ~FrameAllocationScope();
+
+        FrameAllocationScope(const FrameAllocationScope&) = delete;
+        FrameAllocationScope& operator=(const FrameAllocationScope&) = delete;
+
+    private:
+        int previous;
+    };
+
+    // STL allocator over the frame arena of the thread that creates it, the heap outside a scope
+    // A container using it grows and is freed on the thread that made it, and dies with its frame
+    template <typename T>
+    class FrameAllocator
+    {
+    public:
+        typedef T value_type;
+
+        FrameAllocator() : arena(getFrameArena()) {}
+        template <typename U>
+        FrameAllocator(const FrameAllocator<U>& other) : arena(other.getArena()) {}
+
+        T* allocate(size_t count) {
+            if (arena == NULL)
+                return static_cast<T*>(::operator new(count * sizeof(T)));
+            return static_cast<T*>(arena->allocate(count * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T* block, size_t count) {
+            if (arena == NULL)
+                ::operator delete(block);
+            else
+                arena->deallocate(block, count * sizeof(T));
+        }
+
+        FrameArena* getArena() const { return arena; }
+
+    private:
+        FrameArena* arena;
+    };
+
+    template <typename T, typename U>
+    bool operator==(const FrameAllocator<T>& a, const FrameAllocator<U>& b) {
+        return a.getArena() == b.getArena();
+    }
+
+    template <typename T, typename U>
+    bool operator!=(const FrameAllocator<T>& a, const FrameAllocator<U>& b) {
+        return a.getArena() != b.getArena();
+    }
+
+    template <typename T>
+    using FrameVector = std::vector<T, FrameAllocator<T> >;
+}
+
+#endif /* FrameArena_hpp */
@@ -0,0 +1,90 @@
+#include "FramePipeline.hpp"
+
+namespace gps {
+
+    FramePipeline::FramePipeline() : nextSimulation(0), nextRender(0), stopped(false) {
+        for (int i = 0; i < PACKET_COUNT; i++) {
+            states[i] = PACKET_FREE;
+            inputTimes[i] = 0.0;
+        }
+        resetStats();
+    }
+
+    int FramePipeline::acquireForSimulation() {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return stopped || states[nextSimulation] == PACKET_FREE; });
+        if (stopped)
+            return -1;
+
+        int packet = nextSimulation;
+        states[packet] = PACKET_SIMULATING;
+        nextSimulation = (nextSimulation + 1) % PACKET_COUNT;
+        return packet;
+    }
+
+    void FramePipeline::publish(int packet, double inputTime) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            states[packet] = PACKET_READY;
+            inputTimes[packet] = inputTime;
+        }
+        changed.notify_all();
+    }
+
+    int FramePipeline::acquireForRender() {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return stopped || states[nextRender] == PACKET_READY; });
+        if (stopped)
+            return -1;
+
+        int packet = nextRender;
+        states[packet] = PACKET_RENDERING;
+        nextRender = (nextRender + 1) % PACKET_COUNT;
+        return packet;
+    }
+
+    void FramePipeline::release(int packet, double presentTime) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            states[packet] = PACKET_FREE;
+
+            double latency = (presentTime - inputTimes[packet]) * 1000.0;
+            if (frames == 0)
+                firstPresent = presentTime;
+            lastPresent = presentTime;
+            frames++;
+            totalLatency += latency;
+            if (latency > maxLatency)
+                maxLatency = latency;
+        }
+        changed.notify_all();
+    }
+
+    void FramePipeline::stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopped = true;
+        }
+        changed.notify_all();
+    }
+
+    FramePipelineStats FramePipeline::getStats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        FramePipelineStats stats;
+        stats.frames = frames;
+        stats.averageLatency = frames != 0 ? totalLatency / frames : 0.0;
+        stats.maxLatency = maxLatency;
+        // frames - 1 intervals between the first and the last present
+        stats.framesPerSecond = frames > 1 && lastPresent > firstPresent ? (frames - 1) / (lastPresent - firstPresent) : 0.0;
+        return stats;
+    }
+
+    void FramePipeline::resetStats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        frames = 0;
+        totalLatency = 0.0;
+        maxLatency = 0.0;
+        firstPresent = 0.0;
+        lastPresent = 0.0;
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef FramePipeline_hpp
+#define FramePipeline_hpp
+
+#include <condition_variable>
+#include <mutex>
+
+namespace gps {
+
+    // Latency and throughput of the frames presented since the last reset, times in ms
+    struct FramePipelineStats {
+        unsigned int frames;
+        double averageLatency;
+        double maxLatency;
+        double framesPerSecond;
+    };
+
+    // Hands frames from the simulation to the render thread through two packets
+    //
+    // The simulation fills one packet while the render thread draws the other; each side only
+    // blocks when it would overtake the other, so frame N+1 is simulated while frame N is
+    // submitted. The pipeline only tracks which packet is whose, the packets belong to the caller.
+    // Latency runs from the input a frame was simulated with to the moment it was presented.
+    // Both sides may be the same thread, then it simply alternates between them.
+    class FramePipeline
+    {
+    public:
+        static const int PACKET_COUNT = 2;
+
+        FramePipeline();
+
+        // Simulation side: index of the packet to fill, -1 once stop() was called
+        int acquireForSimulation();
+        // inputTime is when the input of the frame was read, in seconds on the clock given to release()
+        void publish(int packet, double inputTime);
+
+        // Render side: the oldest published packet, -1 once stop() was called
+        int acquireForRender();
+        void release(int packet, double presentTime);
+
+        // Wakes up both sides, every acquire returns -1 from now on
+        void stop();
+
+        FramePipelineStats getStats() const;
+        void resetStats();
+
+    private:
+        enum PacketState {
+            PACKET_FREE,
+            PACKET_SIMULATING,
+            PACKET_READY,
+            PACKET_RENDERING
+        };
+
+        mutable std::mutex mutex;
+        std::condition_variable changed;
+        PacketState states[PACKET_COUNT];
+        double inputTimes[PACKET_COUNT];
+        int nextSimulation;
+        int nextRender;
+        bool stopped;
+
+        unsigned int frames;
+        double totalLatency;
+        double maxLatency;
+        double firstPresent;
+        double lastPresent;
+    };
+}
+
+#endif /* FramePipeline_hpp */
@@ -0,0 +1,224 @@
+#include "FrustumCulling.hpp"
+
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define GPS_CULL_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GPS_CULL_SSE2
+#endif
+
+namespace gps {
+
+    Frustum extractFrustum(const glm::mat4& m) {
+        // rows of the matrix, glm is column major
+        glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+        Frustum frustum;
+        frustum.planes[0] = row3 + row0;
+        frustum.planes[1] = row3 - row0;
+        frustum.planes[2] = row3 + row1;
+        frustum.planes[3] = row3 - row1;
+        frustum.planes[4] = row3 + row2;
+        frustum.planes[5] = row3 - row2;
+
+        for (int i = 0; i < 6; i++) {
+            glm::vec4& plane = frustum.planes[i];
+            float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+            plane = plane / length;
+        }
+
+        return frustum;
+    }
+
+    void BoundsSoA::clear() {
+        resize(0);
+    }
+
+    void BoundsSoA::resize(size_t count) {
+        centerX.resize(count);
+        centerY.resize(count);
+        centerZ.resize(count);
+        extentX.resize(count);
+        extentY.resize(count);
+        extentZ.resize(count);
+    }
+
+    size_t BoundsSoA::size() const {
+        return centerX.size();
+    }
+
+    void BoundsSoA::set(size_t index, const glm::vec3& center, const glm::vec3& extent) {
+        centerX[index] = center.x;
+        centerY[index] = center.y;
+        centerZ[index] = center.z;
+        extentX[index] = extent.x;
+        extentY[index] = extent.y;
+        extentZ[index] = extent.z;
+    }
+
+    void BoundsSoA::set(size_t index, const Bounds& bounds, const glm::mat4& world) {
+        glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+        glm::vec3 extent = (bounds.max - bounds.min) * 0.5f;
+
+        glm::vec3 worldCenter = glm::vec3(world * glm::vec4(center, 1.0f));
+        // each world axis gets the absolute contribution of every local axis
+        glm::vec3 worldExtent(0.0f);
+        for (int axis = 0; axis < 3; axis++) {
+            worldExtent.x += std::fabs(world[axis][0]) * extent[axis];
+            worldExtent.y += std::fabs(world[axis][1]) * extent[axis];
+            worldExtent.z += std::fabs(world[axis][2]) * extent[axis];
+        }
+
+        set(index, worldCenter, worldExtent);
+    }
+
+    size_t BoundsSoA::add(const glm::vec3& center, const glm::vec3& extent) {
+        size_t index = size();
+        resize(index + 1);
+        set(index, center, extent);
+        return index;
+    }
+
+    glm::vec3 BoundsSoA::getCenter(size_t index) const {
+        return glm::vec3(centerX[index], centerY[index], centerZ[index]);
+    }
+
+    glm::vec3 BoundsSoA::getExtent(size_t index) const {
+        return glm::vec3(extentX[index], extentY[index], extentZ[index]);
+    }
+
+    // a box is outside if it is entirely on the outer side of any plane
+    static bool boxVisible(const Frustum& frustum, const BoundsSoA& bounds, size_t i) {
+        for (int p = 0; p < 6; p++) {
+            const glm::vec4& plane = frustum.planes[p];
+            float distance = plane.x * bounds.centerX[i] + plane.y * bounds.centerY[i] + plane.z * bounds.centerZ[i] + plane.w;
+            float radius = std::fabs(plane.x) * bounds.extentX[i] + std::fabs(plane.y) * bounds.extentY[i] + std::fabs(plane.z) * bounds.extentZ[i];
+            if (distance + radius < 0.0f)
+                return false;
+        }
+        return true;
+    }
+
+    size_t cullBoundsScalar(const Frustum& frustum, const BoundsSoA& bounds, std::vector<uint32_t>& visible) {
+        visible.clear();
+        for (size_t i = 0; i < bounds.size(); i++) {
+            if (boxVisible(frustum, bounds, i))
+                visible.push_back((uint32_t)i);
+        }
+        return visible.size();
+    }
+
+#if defined(GPS_CULL_AVX)
+
+    size_t cullBoundsRange(const Frustum& frustum, const BoundsSoA& bounds, size_t begin, size_t end, std::vector<uint32_t>& visible) {
+        visible.clear();
+        size_t simdEnd = begin + ((end - begin) & ~(size_t)7);
+        const __m256 signMask = _mm256_set1_ps(-0.0f);
+
+        for (size_t i = begin; i < simdEnd; i += 8) {
+            __m256 cx = _mm256_loadu_ps(&bounds.centerX[i]);
+            __m256 cy = _mm256_loadu_ps(&bounds.centerY[i]);
+            __m256 cz = _mm256_loadu_ps(&bounds.centerZ[i]);
+            __m256 ex = _mm256_loadu_ps(&bounds.extentX[i]);
+            __m256 ey = _mm256_loadu_ps(&bounds.extentY[i]);
+            __m256 ez = _mm256_loadu_ps(&bounds.extentZ[i]);
+            __m256 outside = _mm256_setzero_ps();
+
+            for (int p = 0; p < 6; p++) {
+                const glm::vec4& plane = frustum.planes[p];
+                __m256 nx = _mm256_set1_ps(plane.x);
+                __m256 ny = _mm256_set1_ps(plane.y);
+                __m256 nz = _mm256_set1_ps(plane.z);
+
+                __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, cx), _mm256_mul_ps(ny, cy)),
+                                                _mm256_add_ps(_mm256_mul_ps(nz, cz), _mm256_set1_ps(plane.w)));
+                __m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_andnot_ps(signMask, nx), ex),
+                                                            _mm256_mul_ps(_mm256_andnot_ps(signMask, ny), ey)),
+                                              _mm256_mul_ps(_mm256_andnot_ps(signMask, nz), ez));
+                outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_LT_OQ));
+            }
+
+            int visibleMask = ~_mm256_movemask_ps(outside) & 0xFF;
+            while (visibleMask) {
+                int lane = 0;
+                while (!(visibleMask & (1 << lane)))
+                    lane++;
+                visible.push_back((uint32_t)(i + lane));
+                visibleMask &= visibleMask - 1;
+            }
+        }
+
+        for (size_t i = simdEnd; i < end; i++) {
+            if (boxVisible(frustum, bounds, i))
+                visible.push_back((uint32_t)i);
+        }
+        return visible.size();
+    }
+
+#elif defined(GPS_CULL_SSE2)
+
+    size_t cullBoundsRange(const Frustum& frustum, const BoundsSoA& bounds, size_t begin, size_t end, std::vector<uint32_t>& visible) {
+        visible.clear();
+        size_t simdEnd = begin + ((end - begin) & ~(size_t)3);
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+
+        for (size_t i = begin; i < simdEnd; i += 4) {
+            __m128 cx = _mm_loadu_ps(&bounds.centerX[i]);
+            __m128 cy = _mm_loadu_ps(&bounds.centerY[i]);
+            __m128 cz = _mm_loadu_ps(&bounds.centerZ[i]);
+            __m128 ex = _mm_loadu_ps(&bounds.extentX[i]);
+            __m128 ey = _mm_loadu_ps(&bounds.extentY[i]);
+            __m128 ez = _mm_loadu_ps(&bounds.extentZ[i]);
+            __m128 outside = _mm_setzero_ps();
+
+            for (int p = 0; p < 6; p++) {
+                const glm::vec4& plane = frustum.planes[p];
+                __m128 nx = _mm_set1_ps(plane.x);
+                __m128 ny = _mm_set1_ps(plane.y);
+                __m128 nz = _mm_set1_ps(plane.z);
+
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)),
+                                             _mm_add_ps(_mm_mul_ps(nz, cz), _mm_set1_ps(plane.w)));
+                __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, nx), ex),
+                                                      _mm_mul_ps(_mm_andnot_ps(signMask, ny), ey)),
+                                           _mm_mul_ps(_mm_andnot_ps(signMask, nz), ez));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+            }
+
+            int visibleMask = ~_mm_movemask_ps(outside) & 0xF;
+            for (int lane = 0; lane < 4; lane++) {
+                if (visibleMask & (1 << lane))
+                    visible.push_back((uint32_t)(i + lane));
+            }
+        }
+
+        for (size_t i = simdEnd; i < end; i++) {
+            if (boxVisible(frustum, bounds, i))
+                visible.push_back((uint32_t)i);
+        }
+        return visible.size();
+    }
+
+#else
+
+    size_t cullBoundsRange(const Frustum& frustum, const BoundsSoA& bounds, size_t begin, size_t end, std::vector<uint32_t>& visible) {
+        visible.clear();
+        for (size_t i = begin; i < end; i++) {
+            if (boxVisible(frustum, bounds, i))
+                visible.push_back((uint32_t)i);
+        }
+        return visible.size();
+    }
+
+#endif
+
+    size_t cullBounds(const Frustum& frustum, const BoundsSoA& bounds, std::vector<uint32_t>& visible) {
+        return cullBoundsRange(frustum, bounds, 0, bounds.size(), visible);
+    }
+}
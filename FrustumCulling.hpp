@@ -0,0 +1,61 @@
+#ifndef FrustumCulling_hpp
+#define FrustumCulling_hpp
+
+#include "glm/glm.hpp"
+
+#include "Mesh.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace gps {
+
+    // Six planes (left, right, bottom, top, near, far) stored as (normal, d)
+    // A point p is on the inner side of a plane when dot(normal, p) + d >= 0
+    struct Frustum {
+        glm::vec4 planes[6];
+    };
+
+    // Extracts the world space frustum planes from projection * view
+    Frustum extractFrustum(const glm::mat4& viewProjection);
+
+    // World space AABBs as center/extent arrays, so they can be tested 4 or 8 at a time
+    class BoundsSoA
+    {
+    public:
+        void clear();
+        void resize(size_t count);
+        size_t size() const;
+
+        void set(size_t index, const glm::vec3& center, const glm::vec3& extent);
+        // Transforms a model space box by a world matrix; the result encloses the transformed box
+        void set(size_t index, const Bounds& bounds, const glm::mat4& world);
+        size_t add(const glm::vec3& center, const glm::vec3& extent);
+
+        glm::vec3 getCenter(size_t index) const;
+        glm::vec3 getExtent(size_t index) const;
+
+        std::vector<float> centerX, centerY, centerZ;
+        std::vector<float> extentX, extentY, extentZ;
+    };
+
+    // Per frame culling counters
+    struct CullStats {
+        unsigned int tested;
+        unsigned int visible;
+        unsigned int culled;
+        // removed by occlusion culling, after the frustum test
+        unsigned int occluded;
+    };
+
+    // Writes the indices of the boxes that intersect the frustum to visible (which is cleared first)
+    // Uses AVX when the build enables it, SSE2 otherwise, and returns the number of visible boxes
+    size_t cullBounds(const Frustum& frustum, const BoundsSoA& bounds, std::vector<uint32_t>& visible);
+    // Same for the boxes [begin, end) only, so chunks of bounds can be culled on different threads
+    size_t cullBoundsRange(const Frustum& frustum, const BoundsSoA& bounds, size_t begin, size_t end, std::vector<uint32_t>& visible);
+
+    // Plain C++ version of cullBounds, kept as the reference for the SIMD paths
+    size_t cullBoundsScalar(const Frustum& frustum, const BoundsSoA& bounds, std::vector<uint32_t>& visible);
+}
+
+#endif /* FrustumCulling_hpp */
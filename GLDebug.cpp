@@ -0,0 +1,111 @@
+#include "GLDebug.hpp"
+
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <mutex>
+
+namespace gps {
+
+    struct DebugMessage {
+        std::string text;
+        GLenum severity;
+        unsigned int count;
+    };
+
+    static bool debugOutputAvailable = false;
+    // the callback can come from a driver thread when the output is asynchronous
+    static std::mutex messagesMutex;
+    // messages are told apart by source, type and id
+    static std::map<unsigned long long, DebugMessage> messages;
+
+    static const char* severityName(GLenum severity) {
+        switch (severity) {
+        case GL_DEBUG_SEVERITY_HIGH: return "high";
+        case GL_DEBUG_SEVERITY_MEDIUM: return "medium";
+        case GL_DEBUG_SEVERITY_LOW: return "low";
+        default: return "notification";
+        }
+    }
+
+    static const char* typeName(GLenum type) {
+        switch (type) {
+        case GL_DEBUG_TYPE_ERROR: return "error";
+        case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated";
+        case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "undefined behavior";
+        case GL_DEBUG_TYPE_PORTABILITY: return "portability";
+        case GL_DEBUG_TYPE_PERFORMANCE: return "performance";
+        case GL_DEBUG_TYPE_MARKER: return "marker";
+        default: return "other";
+        }
+    }
+
+    static void GLAPIENTRY debugCallback(GLenum source, GLenum type, GLuint id, GLenum severity,
+                                         GLsizei length, const GLchar* message, const void* /*userParam*/) {
+        // the groups we push come back as messages too
+        if (type == GL_DEBUG_TYPE_PUSH_GROUP || type == GL_DEBUG_TYPE_POP_GROUP)
+            return;
+
+        unsigned long long key = ((unsigned long long)(source & 0xFFFF) << 48) | ((unsigned long long)(type & 0xFFFF) << 32) | id;
+        std::lock_guard<std::mutex> lock(messagesMutex);
+        DebugMessage& seen = messages[key];
+        if (seen.count++ == 0) {
+            seen.text = std::string(message, length >= 0 ? (size_t)length : strlen(message));
+            seen.severity = severity;
+            std::cerr << "GL " << typeName(type) << " (" << severityName(severity) << ", id " << id << "): " << seen.text << std::endl;
+        }
+    }
+
+    bool installDebugOutput(GLenum minSeverity) {
+        debugOutputAvailable = GLEW_KHR_debug || GLEW_VERSION_4_3;
+        if (!debugOutputAvailable)
+            return false;
+
+        glEnable(GL_DEBUG_OUTPUT);
+#ifdef _DEBUG
+        glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+#endif
+        glDebugMessageCallback(debugCallback, NULL);
+
+        // everything on, then the severities below the minimum off
+        const GLenum severities[] = { GL_DEBUG_SEVERITY_NOTIFICATION, GL_DEBUG_SEVERITY_LOW, GL_DEBUG_SEVERITY_MEDIUM, GL_DEBUG_SEVERITY_HIGH };
+        glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, NULL, GL_TRUE);
+        for (int i = 0; i < 4 && severities[i] != minSeverity; i++)
+            glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, severities[i], 0, NULL, GL_FALSE);
+        return true;
+    }
+
+    GLenum parseDebugSeverity(const char* name) {
+        if (strcmp(name, "notification") == 0)
+            return GL_DEBUG_SEVERITY_NOTIFICATION;
+        if (strcmp(name, "low") == 0)
+            return GL_DEBUG_SEVERITY_LOW;
+        if (strcmp(name, "high") == 0)
+            return GL_DEBUG_SEVERITY_HIGH;
+        return GL_DEBUG_SEVERITY_MEDIUM;
+    }
+
+    void printDebugMessageSummary() {
+        std::lock_guard<std::mutex> lock(messagesMutex);
+        for (std::map<unsigned long long, DebugMessage>::const_iterator it = messages.begin(); it != messages.end(); ++it) {
+            if (it->second.count > 1)
+                std::cerr << "GL message seen " << it->second.count << " times (" << severityName(it->second.severity) << "): "
+                          << it->second.text << std::endl;
+        }
+    }
+
+    void setObjectLabel(GLenum identifier, GLuint name, const std::string& label) {
+        if (debugOutputAvailable && name != 0)
+            glObjectLabel(identifier, name, (GLsizei)label.size(), label.c_str());
+    }
+
+    void pushDebugGroup(const char* name) {
+        if (debugOutputAvailable)
+            glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+    }
+
+    void popDebugGroup() {
+        if (debugOutputAvailable)
+            glPopDebugGroup();
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef GLDebug_hpp
+#define GLDebug_hpp
+
+#include <GL/glew.h>
+
+#include <string>
+
+// glGetError checks after the frame, on in debug builds or with GPS_GL_CHECKS=1
+// glGetError can make the driver synchronize with its thread, so performance builds leave them out
+#ifndef GPS_GL_CHECKS
+#ifdef _DEBUG
+#define GPS_GL_CHECKS 1
+#else
+#define GPS_GL_CHECKS 0
+#endif
+#endif
+
+namespace gps {
+
+    // GL debug output (KHR_debug or GL 4.3)
+    //
+    // The driver reports errors and warnings to a callback as they happen, so nothing has to poll.
+    // A message is printed the first time it comes and counted after that, the counts are printed
+    // by printDebugMessageSummary(). Debug builds also ask for synchronous output, so a message
+    // arrives inside the call that caused it and a breakpoint in the callback finds the culprit.
+    // Labels and groups show up in the messages and in tools like RenderDoc and Nsight.
+    // Without the extension every function here does nothing.
+
+    // Installs the callback on the current context, messages below minSeverity are filtered out
+    // (GL_DEBUG_SEVERITY_NOTIFICATION, _LOW, _MEDIUM or _HIGH); false if there is no debug output
+    bool installDebugOutput(GLenum minSeverity);
+    // Parses "notification", "low", "medium" or "high", defaulting to medium
+    GLenum parseDebugSeverity(const char* name);
+
+    void printDebugMessageSummary();
+
+    // identifier is GL_BUFFER, GL_TEXTURE, GL_PROGRAM, GL_VERTEX_ARRAY, GL_QUERY...
+    void setObjectLabel(GLenum identifier, GLuint name, const std::string& label);
+
+    void pushDebugGroup(const char* name);
+    void popDebugGroup();
+}
+
+#endif /* GLDebug_hpp */
@@ -0,0 +1,90 @@
+#ifndef GLResource_hpp
+#define GLResource_hpp
+
+#include <GL/glew.h>
+
+#include "GpuMemory.hpp"
+
+namespace gps {
+
+    // Owns one OpenGL object name and deletes it when destroyed
+    // Move-only, so every GL object has exactly one owner
+    template <typename Traits>
+    class GLHandle
+    {
+    public:
+        GLHandle() : id(0) {}
+        explicit GLHandle(GLuint id) : id(id) {}
+        ~GLHandle() { reset(); }
+
+        GLHandle(GLHandle&& other) noexcept : id(other.release()) {}
+        GLHandle& operator=(GLHandle&& other) noexcept
+        {
+            if (this != &other)
+                reset(other.release());
+            return *this;
+        }
+
+        GLHandle(const GLHandle&) = delete;
+        GLHandle& operator=(const GLHandle&) = delete;
+
+        // Generates a new object of this type
+        static GLHandle create() { return GLHandle(Traits::create()); }
+
+        GLuint get() const { return id; }
+
+        // Gives up ownership without deleting the object
+        GLuint release()
+        {
+            GLuint oldId = id;
+            id = 0;
+            return oldId;
+        }
+
+        // Deletes the owned object (if any) and takes ownership of newId
+        void reset(GLuint newId = 0)
+        {
+            if (id != 0)
+                Traits::destroy(id);
+            id = newId;
+        }
+
+        explicit operator bool() const { return id != 0; }
+
+    private:
+        GLuint id;
+    };
+
+    struct GLBufferTraits {
+        static GLuint create() { GLuint id; glGenBuffers(1, &id); return id; }
+        static void destroy(GLuint id) { untrackBufferMemory(id); glDeleteBuffers(1, &id); }
+    };
+
+    struct GLVertexArrayTraits {
+        static GLuint create() { GLuint id; glGenVertexArrays(1, &id); return id; }
+        static void destroy(GLuint id) { glDeleteVertexArrays(1, &id); }
+    };
+
+    struct GLTextureTraits {
+        static GLuint create() { GLuint id; glGenTextures(1, &id); return id; }
+        static void destroy(GLuint id) { untrackTextureMemory(id); glDeleteTextures(1, &id); }
+    };
+
+    struct GLProgramTraits {
+        static GLuint create() { return glCreateProgram(); }
+        static void destroy(GLuint id) { glDeleteProgram(id); }
+    };
+
+    struct GLQueryTraits {
+        static GLuint create() { GLuint id; glGenQueries(1, &id); return id; }
+        static void destroy(GLuint id) { glDeleteQueries(1, &id); }
+    };
+
+    typedef GLHandle<GLBufferTraits> GLBuffer;
+    typedef GLHandle<GLVertexArrayTraits> GLVertexArray;
+    typedef GLHandle<GLTextureTraits> GLTexture;
+    typedef GLHandle<GLProgramTraits> GLProgram;
+    typedef GLHandle<GLQueryTraits> GLQuery;
+}
+
+#endif /* GLResource_hpp */
@@ -0,0 +1,141 @@
+#include "GeometryArena.hpp"
+#include "GLDebug.hpp"
+#include "RenderStats.hpp"
+
+namespace gps {
+
+    static const GLuint DEFAULT_VERTEX_CAPACITY = 1 << 16;
+    static const GLuint DEFAULT_INDEX_CAPACITY = 3 << 16;
+
+    GeometryArena::GeometryArena() : vertexCount(0), vertexCapacity(0), indexCount(0), indexCapacity(0) {
+    }
+
+    void GeometryArena::init(GLuint vertexCapacity, GLuint indexCapacity) {
+        this->vertexCount = 0;
+        this->indexCount = 0;
+        this->vertexCapacity = vertexCapacity;
+        this->indexCapacity = indexCapacity;
+
+        VAO = GLVertexArray::create();
+        vertexBuffer = GLBuffer::create();
+        indexBuffer = GLBuffer::create();
+        drawIndexBuffer = GLBuffer::create();
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer.get());
+        glBufferData(GL_COPY_WRITE_BUFFER, vertexCapacity * sizeof(Vertex), NULL, GL_STATIC_DRAW);
+        trackBufferMemory(vertexBuffer.get(), vertexCapacity * sizeof(Vertex), GPU_MEMORY_GEOMETRY, "geometry arena");
+        setObjectLabel(GL_BUFFER, vertexBuffer.get(), "arena vertices");
+        glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer.get());
+        glBufferData(GL_COPY_WRITE_BUFFER, indexCapacity * sizeof(GLuint), NULL, GL_STATIC_DRAW);
+        trackBufferMemory(indexBuffer.get(), indexCapacity * sizeof(GLuint), GPU_MEMORY_GEOMETRY, "geometry arena");
+        setObjectLabel(GL_BUFFER, indexBuffer.get(), "arena indices");
+
+        // 0, 1, 2, ... read with divisor 1, so a draw with base instance i sees i
+        std::vector<GLuint> drawIndices(MAX_DRAWS);
+        for (GLuint i = 0; i < MAX_DRAWS; i++)
+            drawIndices[i] = i;
+        glBindBuffer(GL_COPY_WRITE_BUFFER, drawIndexBuffer.get());
+        glBufferData(GL_COPY_WRITE_BUFFER, drawIndices.size() * sizeof(GLuint), &drawIndices[0], GL_STATIC_DRAW);
+        countBufferUpload(drawIndices.size() * sizeof(GLuint));
+        trackBufferMemory(drawIndexBuffer.get(), drawIndices.size() * sizeof(GLuint), GPU_MEMORY_GEOMETRY, "geometry arena");
+        setObjectLabel(GL_BUFFER, drawIndexBuffer.get(), "arena draw indices");
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        setupVertexAttributes();
+        setObjectLabel(GL_VERTEX_ARRAY, VAO.get(), "arena VAO");
+    }
+
+    void GeometryArena::setupVertexAttributes() {
+        glBindVertexArray(VAO.get());
+
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer.get());
+        // same layout as the VAO of a standalone Mesh
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Normal));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, TexCoords));
+
+        glBindBuffer(GL_ARRAY_BUFFER, drawIndexBuffer.get());
+        glEnableVertexAttribArray(DRAW_INDEX_ATTRIBUTE);
+        glVertexAttribIPointer(DRAW_INDEX_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(GLuint), (GLvoid*)0);
+        glVertexAttribDivisor(DRAW_INDEX_ATTRIBUTE, 1);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer.get());
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void GeometryArena::grow(GLBuffer& buffer, GLsizeiptr usedBytes, GLsizeiptr newBytes, const char* label) {
+        GLBuffer bigger = GLBuffer::create();
+        glBindBuffer(GL_COPY_WRITE_BUFFER, bigger.get());
+        glBufferData(GL_COPY_WRITE_BUFFER, newBytes, NULL, GL_STATIC_DRAW);
+        trackBufferMemory(bigger.get(), newBytes, GPU_MEMORY_GEOMETRY, "geometry arena");
+        setObjectLabel(GL_BUFFER, bigger.get(), label);
+        if (usedBytes > 0) {
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer.get());
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedBytes);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        buffer = std::move(bigger);
+    }
+
+    ArenaRange GeometryArena::add(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices) {
+        if (!VAO)
+            init(DEFAULT_VERTEX_CAPACITY, DEFAULT_INDEX_CAPACITY);
+
+        GLuint newVertexCount = vertexCount + (GLuint)vertices.size();
+        GLuint newIndexCount = indexCount + (GLuint)indices.size();
+        bool grown = false;
+        if (newVertexCount > vertexCapacity) {
+            vertexCapacity = newVertexCount > vertexCapacity * 2 ? newVertexCount : vertexCapacity * 2;
+            grow(vertexBuffer, vertexCount * sizeof(Vertex), vertexCapacity * sizeof(Vertex), "arena vertices");
+            grown = true;
+        }
+        if (newIndexCount > indexCapacity) {
+            indexCapacity = newIndexCount > indexCapacity * 2 ? newIndexCount : indexCapacity * 2;
+            grow(indexBuffer, indexCount * sizeof(GLuint), indexCapacity * sizeof(GLuint), "arena indices");
+            grown = true;
+        }
+        // the VAO keeps its name, so packets that point at it stay valid
+        if (grown)
+            setupVertexAttributes();
+
+        // uploads go through the copy target so the bindings of the VAO are left alone
+        if (!vertices.empty()) {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer.get());
+            glBufferSubData(GL_COPY_WRITE_BUFFER, vertexCount * sizeof(Vertex), vertices.size() * sizeof(Vertex), &vertices[0]);
+            countBufferUpload(vertices.size() * sizeof(Vertex));
+        }
+        if (!indices.empty()) {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer.get());
+            glBufferSubData(GL_COPY_WRITE_BUFFER, indexCount * sizeof(GLuint), indices.size() * sizeof(GLuint), &indices[0]);
+            countBufferUpload(indices.size() * sizeof(GLuint));
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        ArenaRange range;
+        range.firstIndex = indexCount;
+        range.indexCount = (GLsizei)indices.size();
+        range.baseVertex = (GLint)vertexCount;
+
+        vertexCount = newVertexCount;
+        indexCount = newIndexCount;
+        return range;
+    }
+
+    GLuint GeometryArena::getVAO() const {
+        return VAO.get();
+    }
+
+    GLuint GeometryArena::getVertexCount() const {
+        return vertexCount;
+    }
+
+    GLuint GeometryArena::getIndexCount() const {
+        return indexCount;
+    }
+}
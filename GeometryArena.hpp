@@ -0,0 +1,61 @@
+#ifndef GeometryArena_hpp
+#define GeometryArena_hpp
+
+#include <GL/glew.h>
+
+#include "Mesh.hpp"
+#include "GLResource.hpp"
+
+#include <vector>
+
+namespace gps {
+
+    // Where a mesh lives inside a GeometryArena
+    struct ArenaRange {
+        GLuint firstIndex;
+        GLsizei indexCount;
+        GLint baseVertex;
+    };
+
+    // Static geometry of many meshes suballocated from one vertex buffer and one 32 bit index
+    // buffer, behind a single VAO, so any number of meshes can be drawn without rebinding and
+    // merged into multi-draw calls. Allocation is linear; the buffers double when they are full.
+    class GeometryArena
+    {
+    public:
+        // Instanced attribute that yields the base instance of a draw, the index of its per draw data
+        static const GLuint DRAW_INDEX_ATTRIBUTE = 4;
+        static const GLuint MAX_DRAWS = 65536;
+
+        GeometryArena();
+        GeometryArena(GeometryArena&&) = default;
+        GeometryArena& operator=(GeometryArena&&) = default;
+        GeometryArena(const GeometryArena&) = delete;
+        GeometryArena& operator=(const GeometryArena&) = delete;
+
+        // Creates the VAO and the buffers with room for the given counts
+        // Optional, the first add() does it with default sizes
+        void init(GLuint vertexCapacity, GLuint indexCapacity);
+
+        // Copies a mesh in; its indices stay relative to its first vertex
+        ArenaRange add(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices);
+
+        GLuint getVAO() const;
+        GLuint getVertexCount() const;
+        GLuint getIndexCount() const;
+
+    private:
+        GLVertexArray VAO;
+        GLBuffer vertexBuffer;
+        GLBuffer indexBuffer;
+        GLBuffer drawIndexBuffer;
+        GLuint vertexCount, vertexCapacity;
+        GLuint indexCount, indexCapacity;
+
+        // Replaces buffer with a bigger one holding the same first usedBytes
+        static void grow(GLBuffer& buffer, GLsizeiptr usedBytes, GLsizeiptr newBytes, const char* label);
+        void setupVertexAttributes();
+    };
+}
+
+#endif /* GeometryArena_hpp */
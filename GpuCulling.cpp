@@ -0,0 +1,278 @@
+#include "GpuCulling.hpp"
+#include "RenderQueue.hpp"
+#include "GLDebug.hpp"
+#include "RenderStats.hpp"
+
+#include "glm/gtc/matrix_inverse.hpp"
+#include "glm/gtc/type_ptr.hpp"
+
+#include <cstring>
+
+namespace gps {
+
+    static const GLuint WORKGROUP_SIZE = 64;
+
+    static GLint location(const Shader& shader, const char* name) {
+        return glGetUniformLocation(shader.shaderProgram.get(), name);
+    }
+
+    // creates buffer if needed and fills it, size 0 still gets a valid buffer
+    static void uploadBuffer(GLBuffer& buffer, GLsizeiptr size, const void* data, GLenum usage, const char* label) {
+        if (!buffer)
+            buffer = GLBuffer::create();
+        GLuint zero = 0;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer.get());
+        glBufferData(GL_SHADER_STORAGE_BUFFER, size > 0 ? size : sizeof(zero), size > 0 ? data : &zero, usage);
+        countBufferUpload(size > 0 ? (size_t)size : sizeof(zero));
+        trackBufferMemory(buffer.get(), size > 0 ? (size_t)size : sizeof(zero), GPU_MEMORY_SHADER_DATA, "gpu culling");
+        setObjectLabel(GL_BUFFER, buffer.get(), label);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    bool GpuCuller::isSupported() {
+        return GLEW_VERSION_4_3 && (GLEW_VERSION_4_6 || GLEW_ARB_shader_draw_parameters);
+    }
+
+    GpuCuller::GpuCuller() : indirectCount(false), arenaVAO(0), hiZWidth(0), hiZHeight(0), hiZLevels(0) {
+    }
+
+    void GpuCuller::init() {
+        cullShader.loadComputeShader("shaders/gpuCull.comp");
+        compactShader.loadComputeShader("shaders/gpuCompact.comp");
+        indirectCount = GLEW_ARB_indirect_parameters != 0;
+    }
+
+    GLuint GpuCuller::addPrototype(const Model3D& model) {
+        const std::vector<Bounds>& meshBounds = model.getMeshBounds();
+        Bounds bounds;
+        bounds.min = bounds.max = glm::vec3(0.0f);
+        for (size_t i = 0; i < meshBounds.size(); i++) {
+            bounds.min = i == 0 ? meshBounds[i].min : glm::min(bounds.min, meshBounds[i].min);
+            bounds.max = i == 0 ? meshBounds[i].max : glm::max(bounds.max, meshBounds[i].max);
+        }
+
+        GpuPrototype prototype = GpuPrototype();
+        prototype.center = glm::vec4((bounds.min + bounds.max) * 0.5f, 1.0f);
+        prototype.extent = glm::vec4((bounds.max - bounds.min) * 0.5f, 0.0f);
+        prototypes.push_back(prototype);
+        return (GLuint)prototypes.size() - 1;
+    }
+
+    void GpuCuller::addLod(GLuint prototype, const Model3D& model, float maxDistance) {
+        GpuPrototype& target = prototypes[prototype];
+        if (target.lodCount == MAX_LODS)
+            return;
+
+        const std::vector<DrawPacket>& packets = model.getDrawPackets();
+        GpuLod& lod = target.lods[target.lodCount++];
+        lod.firstSlot = (GLuint)slots.size();
+        lod.slotCount = (GLuint)packets.size();
+        lod.maxDistance = maxDistance;
+
+        for (size_t i = 0; i < packets.size(); i++) {
+            GpuDrawSlot slot = GpuDrawSlot();
+            slot.count = packets[i].indexCount;
+            slot.firstIndex = packets[i].indexOffset / sizeof(GLuint);
+            slot.baseVertex = packets[i].baseVertex;
+            slot.materialId = packets[i].materialId;
+            slots.push_back(slot);
+            slotPackets.push_back(packets[i]);
+            slotPrototypes.push_back(prototype);
+            arenaVAO = packets[i].VAO;
+        }
+    }
+
+    GLuint GpuCuller::addInstance(GLuint prototype, const glm::mat4& world) {
+        GpuInstance instance = GpuInstance();
+        instance.model = world;
+        instance.normalMatrix = glm::mat4(glm::inverseTranspose(glm::mat3(world)));
+        instance.prototype = prototype;
+        instances.push_back(instance);
+        return (GLuint)instances.size() - 1;
+    }
+
+    void GpuCuller::upload() {
+        // every slot can hold all the instances of its prototype
+        std::vector<GLuint> prototypeInstances(prototypes.size(), 0);
+        for (size_t i = 0; i < instances.size(); i++)
+            prototypeInstances[instances[i].prototype]++;
+
+        GLuint instanceOffset = 0;
+        for (size_t i = 0; i < slots.size(); i++) {
+            slots[i].instanceOffset = instanceOffset;
+            instanceOffset += prototypeInstances[slotPrototypes[i]];
+        }
+
+        // slots with the same textures share a bucket, each bucket gets a range of commands
+        buckets.clear();
+        for (size_t i = 0; i < slots.size(); i++) {
+            size_t b = 0;
+            while (b < buckets.size() && memcmp(buckets[b].textures, slotPackets[i].textures, sizeof(buckets[b].textures)) != 0)
+                b++;
+            if (b == buckets.size()) {
+                Bucket bucket;
+                memcpy(bucket.textures, slotPackets[i].textures, sizeof(bucket.textures));
+                bucket.commandBase = 0;
+                bucket.slotCount = 0;
+                buckets.push_back(bucket);
+            }
+            slots[i].bucket = (GLuint)b;
+            slots[i].indexInBucket = buckets[b].slotCount++;
+        }
+
+        GLuint commandBase = 0;
+        for (size_t b = 0; b < buckets.size(); b++) {
+            buckets[b].commandBase = commandBase;
+            commandBase += buckets[b].slotCount;
+        }
+        for (size_t i = 0; i < slots.size(); i++)
+            slots[i].commandBase = buckets[slots[i].bucket].commandBase;
+
+        uploadBuffer(instanceBuffer, instances.size() * sizeof(GpuInstance), instances.empty() ? NULL : &instances[0], GL_STATIC_DRAW, "cull instances");
+        uploadBuffer(prototypeBuffer, prototypes.size() * sizeof(GpuPrototype), prototypes.empty() ? NULL : &prototypes[0], GL_STATIC_DRAW, "cull prototypes");
+        uploadBuffer(slotBuffer, slots.size() * sizeof(GpuDrawSlot), slots.empty() ? NULL : &slots[0], GL_STATIC_DRAW, "cull draw slots");
+        uploadBuffer(slotCountBuffer, slots.size() * sizeof(GLuint), NULL, GL_DYNAMIC_COPY, "cull slot counts");
+        uploadBuffer(visibleBuffer, instanceOffset * sizeof(GLuint), NULL, GL_DYNAMIC_COPY, "cull visible instances");
+        uploadBuffer(bucketCountBuffer, buckets.size() * sizeof(GLuint), NULL, GL_DYNAMIC_COPY, "cull bucket counts");
+        uploadBuffer(commandBuffer, slots.size() * sizeof(DrawElementsIndirectCommand), NULL, GL_DYNAMIC_COPY, "cull commands");
+        uploadBuffer(commandSlotBuffer, slots.size() * sizeof(GLuint), NULL, GL_DYNAMIC_COPY, "cull command slots");
+    }
+
+    bool GpuCuller::uploadHiZ(const OcclusionCuller& hiZ) {
+        int width = hiZ.getLevelWidth(0);
+        int height = hiZ.getLevelHeight(0);
+        int levels = (int)hiZ.getLevelCount();
+        for (int level = 0; level < levels; level++) {
+            int mipWidth = width >> level > 1 ? width >> level : 1;
+            int mipHeight = height >> level > 1 ? height >> level : 1;
+            if (hiZ.getLevelWidth(level) != mipWidth || hiZ.getLevelHeight(level) != mipHeight)
+                return false;
+        }
+
+        // texture storage is immutable, so a new size needs a new texture
+        if (!hiZTexture || width != hiZWidth || height != hiZHeight || levels != hiZLevels) {
+            hiZTexture = GLTexture::create();
+            glBindTexture(GL_TEXTURE_2D, hiZTexture.get());
+            glTexStorage2D(GL_TEXTURE_2D, levels, GL_R32F, width, height);
+            trackTextureMemory(hiZTexture.get(), textureStorageBytes(GL_R32F, width, height, 1, levels, 1), GPU_MEMORY_TEXTURES, "gpu culling");
+            setObjectLabel(GL_TEXTURE, hiZTexture.get(), "hi-z pyramid");
+            hiZWidth = width;
+            hiZHeight = height;
+            hiZLevels = levels;
+        }
+
+        glBindTexture(GL_TEXTURE_2D, hiZTexture.get());
+        for (int level = 0; level < levels; level++) {
+            glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, hiZ.getLevelWidth(level), hiZ.getLevelHeight(level),
+                GL_RED, GL_FLOAT, &hiZ.getLevel(level)[0]);
+            countTextureUpload((size_t)hiZ.getLevelWidth(level) * hiZ.getLevelHeight(level) * sizeof(float));
+        }
+        return true;
+    }
+
+    void GpuCuller::cull(const Frustum& frustum, const glm::vec3& cameraPosition, const OcclusionCuller* hiZ) {
+        if (instances.empty() || slots.empty())
+            return;
+
+        glActiveTexture(GL_TEXTURE0);
+        bool useHiZ = hiZ != NULL && uploadHiZ(*hiZ);
+
+        GLuint zero = 0;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, slotCountBuffer.get());
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, bucketCountBuffer.get());
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        // cull every instance and append the visible ones to the lists of their LOD meshes
+        cullShader.useShaderProgram();
+        glUniform1ui(location(cullShader, "instanceCount"), (GLuint)instances.size());
+        glUniform4fv(location(cullShader, "frustumPlanes"), 6, glm::value_ptr(frustum.planes[0]));
+        glUniform3fv(location(cullShader, "cameraPosition"), 1, glm::value_ptr(cameraPosition));
+        glUniform1i(location(cullShader, "hiZEnabled"), useHiZ);
+        if (useHiZ) {
+            glUniformMatrix4fv(location(cullShader, "hiZViewProjection"), 1, GL_FALSE, glm::value_ptr(hiZ->getViewProjection()));
+            glUniform2i(location(cullShader, "hiZSize"), hiZWidth, hiZHeight);
+            glUniform1i(location(cullShader, "hiZLevels"), hiZLevels);
+            glUniform1i(location(cullShader, "hiZ"), 0);
+        }
+        countProgramBind();
+        countUniformBytes(sizeof(GLuint) + sizeof(frustum.planes) + sizeof(glm::vec3) + sizeof(GLint)
+            + (useHiZ ? sizeof(glm::mat4) + 4 * sizeof(GLint) : 0));
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, instanceBuffer.get());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PROTOTYPE_BINDING, prototypeBuffer.get());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SLOT_BINDING, slotBuffer.get());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SLOT_COUNT_BINDING, slotCountBuffer.get());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VISIBLE_BINDING, visibleBuffer.get());
+        glDispatchCompute(((GLuint)instances.size() + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        // turn the lists into indirect commands
+        compactShader.useShaderProgram();
+        glUniform1ui(location(compactShader, "slotCount"), (GLuint)slots.size());
+        glUniform1i(location(compactShader, "compact"), indirectCount);
+        countProgramBind();
+        countUniformBytes(sizeof(GLuint) + sizeof(GLint));
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BUCKET_COUNT_BINDING, bucketCountBuffer.get());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, commandBuffer.get());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_SLOT_BINDING, commandSlotBuffer.get());
+        glDispatchCompute(((GLuint)slots.size() + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    void GpuCuller::draw(const Shader& shader) {
+        if (instances.empty() || slots.empty())
+            return;
+
+        shader.useShaderProgram();
+        for (GLuint slot = 0; slot < TEXTURE_SLOT_COUNT; slot++)
+            glUniform1i(location(shader, TextureSlotNames[slot]), slot);
+        GLint drawBaseLoc = location(shader, "drawBase");
+        countProgramBind();
+        countUniformBytes(TEXTURE_SLOT_COUNT * sizeof(GLint));
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, instanceBuffer.get());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SLOT_BINDING, slotBuffer.get());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VISIBLE_BINDING, visibleBuffer.get());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_SLOT_BINDING, commandSlotBuffer.get());
+
+        // the draw index attribute of the arena would be fetched past its end with these base instances
+        glBindVertexArray(arenaVAO);
+        countVaoBind();
+        glDisableVertexAttribArray(GeometryArena::DRAW_INDEX_ATTRIBUTE);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer.get());
+        if (indirectCount)
+            glBindBuffer(GL_PARAMETER_BUFFER_ARB, bucketCountBuffer.get());
+
+        for (size_t b = 0; b < buckets.size(); b++) {
+            const Bucket& bucket = buckets[b];
+            for (GLuint slot = 0; slot < TEXTURE_SLOT_COUNT; slot++) {
+                glActiveTexture(GL_TEXTURE0 + slot);
+                glBindTexture(GL_TEXTURE_2D, bucket.textures[slot]);
+            }
+            glUniform1ui(drawBaseLoc, bucket.commandBase);
+            countTextureBinds(TEXTURE_SLOT_COUNT);
+            countUniformBytes(sizeof(GLuint));
+
+            const GLvoid* commands = (GLvoid*)(uintptr_t)(bucket.commandBase * sizeof(DrawElementsIndirectCommand));
+            if (indirectCount)
+                glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT, commands, (GLintptr)(b * sizeof(GLuint)), bucket.slotCount, 0);
+            else
+                glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, commands, bucket.slotCount, 0);
+            // the culling shader wrote the counts, they never come back to the CPU
+            countIndirectDraw();
+        }
+
+        if (indirectCount)
+            glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        glEnableVertexAttribArray(GeometryArena::DRAW_INDEX_ATTRIBUTE);
+        glBindVertexArray(0);
+    }
+
+    size_t GpuCuller::getInstanceCount() const {
+        return instances.size();
+    }
+}
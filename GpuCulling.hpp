@@ -0,0 +1,146 @@
+#ifndef GpuCulling_hpp
+#define GpuCulling_hpp
+
+#include <GL/glew.h>
+#include "glm/glm.hpp"
+
+#include "Shader.hpp"
+#include "Model3D.hpp"
+#include "GLResource.hpp"
+#include "FrustumCulling.hpp"
+#include "OcclusionCulling.hpp"
+
+#include <vector>
+
+namespace gps {
+
+    // GPU driven culling of instanced props (scattered logs, rocks, grass...)
+    //
+    // Instances and their prototypes live in shader storage buffers. Every frame a compute pass
+    // tests each instance against the frustum and the Hi-Z pyramid of the OcclusionCuller, picks
+    // a LOD by distance and appends the visible ones to the instance list of every mesh of that
+    // LOD. A second pass turns the non empty lists into compacted DrawElementsIndirectCommands,
+    // one group per texture set, drawn with glMultiDrawElementsIndirectCount. The CPU cost per
+    // frame does not depend on the number of instances.
+    //
+    // Needs GL 4.3 with ARB_shader_draw_parameters; without ARB_indirect_parameters every mesh
+    // gets a command, with 0 instances if nothing is visible.
+    class GpuCuller
+    {
+    public:
+        static const int MAX_LODS = 4;
+
+        // shader storage bindings, every pass binds what it uses right before it runs
+        static const GLuint INSTANCE_BINDING = 0;
+        static const GLuint PROTOTYPE_BINDING = 1;
+        static const GLuint SLOT_BINDING = 2;
+        static const GLuint SLOT_COUNT_BINDING = 3;
+        static const GLuint VISIBLE_BINDING = 4;
+        static const GLuint BUCKET_COUNT_BINDING = 5;
+        static const GLuint COMMAND_BINDING = 6;
+        static const GLuint COMMAND_SLOT_BINDING = 7;
+
+        static bool isSupported();
+
+        GpuCuller();
+        GpuCuller(GpuCuller&&) = default;
+        GpuCuller& operator=(GpuCuller&&) = default;
+        GpuCuller(const GpuCuller&) = delete;
+        GpuCuller& operator=(const GpuCuller&) = delete;
+
+        // Loads the compute shaders
+        void init();
+
+        // Something to instance, bounded by the meshes of model (its first LOD)
+        GLuint addPrototype(const Model3D& model);
+        // LODs go nearest first; this one is used up to maxDistance from the camera
+        // The model must have been loaded into a GeometryArena
+        void addLod(GLuint prototype, const Model3D& model, float maxDistance);
+        GLuint addInstance(GLuint prototype, const glm::mat4& world);
+
+        // Sends everything added so far to the GPU
+        void upload();
+
+        // Runs the culling passes; hiZ may be NULL, otherwise it must have been rendered this frame
+        void cull(const Frustum& frustum, const glm::vec3& cameraPosition, const OcclusionCuller* hiZ);
+
+        // Draws what the last cull() kept, the shader reads the instance buffers (basicInstanced.vert)
+        void draw(const Shader& shader);
+
+        size_t getInstanceCount() const;
+
+    private:
+        // std430 layouts, mirrored in the shaders
+        struct GpuInstance {
+            glm::mat4 model;
+            glm::mat4 normalMatrix;
+            GLuint prototype;
+            GLuint padding[3];
+        };
+
+        struct GpuLod {
+            GLuint firstSlot;
+            GLuint slotCount;
+            float maxDistance;
+            GLuint padding;
+        };
+
+        struct GpuPrototype {
+            glm::vec4 center;
+            glm::vec4 extent;
+            GpuLod lods[MAX_LODS];
+            GLuint lodCount;
+            GLuint padding[3];
+        };
+
+        // one mesh of one LOD, it gets its own indirect command
+        struct GpuDrawSlot {
+            GLuint count;
+            GLuint firstIndex;
+            GLint baseVertex;
+            GLuint materialId;
+            // first entry of its visible instance list
+            GLuint instanceOffset;
+            // first command of its bucket and its place in it when commands are not compacted
+            GLuint commandBase;
+            GLuint indexInBucket;
+            GLuint bucket;
+        };
+
+        // slots that share textures, drawn with one call
+        struct Bucket {
+            GLuint textures[TEXTURE_SLOT_COUNT];
+            GLuint commandBase;
+            GLsizei slotCount;
+        };
+
+        Shader cullShader;
+        Shader compactShader;
+        bool indirectCount;
+        GLuint arenaVAO;
+
+        std::vector<GpuInstance> instances;
+        std::vector<GpuPrototype> prototypes;
+        std::vector<GpuDrawSlot> slots;
+        // packet and prototype of every slot, upload() sorts the slots into buckets with them
+        std::vector<DrawPacket> slotPackets;
+        std::vector<GLuint> slotPrototypes;
+        std::vector<Bucket> buckets;
+
+        GLBuffer instanceBuffer;
+        GLBuffer prototypeBuffer;
+        GLBuffer slotBuffer;
+        GLBuffer slotCountBuffer;
+        GLBuffer visibleBuffer;
+        GLBuffer bucketCountBuffer;
+        GLBuffer commandBuffer;
+        GLBuffer commandSlotBuffer;
+        GLTexture hiZTexture;
+        int hiZWidth, hiZHeight, hiZLevels;
+
+        // false if the pyramid does not map onto a mip chain (sizes that are not powers of two)
+        bool uploadHiZ(const OcclusionCuller& hiZ);
+    };
+}
+
+#endif /* GpuCulling_hpp */
@@ -0,0 +1,258 @@
+#include "GpuMemory.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <map>
+
+namespace gps {
+
+    struct Allocation {
+        size_t bytes;
+        GpuMemoryCategory category;
+        std::string asset;
+    };
+
+    static const char* const categoryNames[GPU_MEMORY_CATEGORY_COUNT] = {
+        "geometry", "textures", "shader data", "streaming", "framebuffers"
+    };
+
+    struct Registry {
+        std::map<GLuint, Allocation> buffers;
+        std::map<GLuint, Allocation> textures;
+        std::map<std::string, Allocation> surfaces;
+        size_t categoryTotals[GPU_MEMORY_CATEGORY_COUNT];
+        size_t total;
+
+        size_t totalBudget;
+        size_t categoryBudgets[GPU_MEMORY_CATEGORY_COUNT];
+        // so a budget warns once each time it is crossed, not on every allocation over it
+        bool totalOverBudget;
+        bool categoryOverBudget[GPU_MEMORY_CATEGORY_COUNT];
+
+        std::string currentAsset;
+
+        Registry() : categoryTotals(), total(0), totalBudget(0), categoryBudgets(), totalOverBudget(false),
+                     categoryOverBudget(), currentAsset("unattributed") {}
+    };
+
+    // never destroyed, global handles of other files untrack themselves during static destruction
+    static Registry& registry() {
+        static Registry* instance = new Registry();
+        return *instance;
+    }
+
+    static double megabytes(size_t bytes) {
+        return bytes / (1024.0 * 1024.0);
+    }
+
+    static bool checkBudget(size_t used, size_t budget, bool& over, const char* name) {
+        if (budget == 0 || used <= budget) {
+            over = false;
+            return true;
+        }
+        if (!over)
+            std::cerr << "GPU memory over budget: " << name << " " << megabytes(used) << " MB of " << megabytes(budget) << " MB" << std::endl;
+        over = true;
+        return false;
+    }
+
+    static void subtract(Registry& memory, const Allocation& allocation) {
+        memory.categoryTotals[allocation.category] -= allocation.bytes;
+        memory.total -= allocation.bytes;
+    }
+
+    template <typename Key>
+    static bool track(std::map<Key, Allocation>& allocations, const Key& key, size_t bytes, GpuMemoryCategory category, const char* asset) {
+        Registry& memory = registry();
+        typename std::map<Key, Allocation>::iterator it = allocations.find(key);
+        if (it != allocations.end())
+            subtract(memory, it->second);
+        else
+            it = allocations.insert(std::make_pair(key, Allocation())).first;
+
+        Allocation& allocation = it->second;
+        allocation.bytes = bytes;
+        allocation.category = category;
+        allocation.asset = asset ? asset : memory.currentAsset;
+        memory.categoryTotals[category] += bytes;
+        memory.total += bytes;
+
+        bool withinCategory = checkBudget(memory.categoryTotals[category], memory.categoryBudgets[category],
+            memory.categoryOverBudget[category], categoryNames[category]);
+        bool withinTotal = checkBudget(memory.total, memory.totalBudget, memory.totalOverBudget, "total");
+        return withinCategory && withinTotal;
+    }
+
+    template <typename Key>
+    static void untrack(std::map<Key, Allocation>& allocations, const Key& key) {
+        typename std::map<Key, Allocation>::iterator it = allocations.find(key);
+        if (it == allocations.end())
+            return;
+        subtract(registry(), it->second);
+        allocations.erase(it);
+    }
+
+    bool trackBufferMemory(GLuint buffer, size_t bytes, GpuMemoryCategory category, const char* asset) {
+        return track(registry().buffers, buffer, bytes, category, asset);
+    }
+
+    bool trackTextureMemory(GLuint texture, size_t bytes, GpuMemoryCategory category, const char* asset) {
+        return track(registry().textures, texture, bytes, category, asset);
+    }
+
+    bool trackSurfaceMemory(const std::string& name, size_t bytes, GpuMemoryCategory category, const char* asset) {
+        return track(registry().surfaces, name, bytes, category, asset);
+    }
+
+    void untrackBufferMemory(GLuint buffer) {
+        untrack(registry().buffers, buffer);
+    }
+
+    void untrackTextureMemory(GLuint texture) {
+        untrack(registry().textures, texture);
+    }
+
+    static size_t bytesPerTexel(GLenum internalFormat) {
+        switch (internalFormat) {
+        case GL_R8: return 1;
+        case GL_RG8: case GL_R16F: return 2;
+        case GL_RGBA16F: case GL_RG32F: case GL_DEPTH32F_STENCIL8: return 8;
+        case GL_RGBA32F: return 16;
+        // RGB formats are padded to 4 bytes by every driver that matters
+        default: return 4;
+        }
+    }
+
+    size_t textureStorageBytes(GLenum internalFormat, int width, int height, int depth, int levels, int samples) {
+        if (levels == 0) {
+            levels = 1;
+            for (int size = width > height ? width : height; size > 1; size /= 2)
+                levels++;
+        }
+        size_t texels = 0;
+        for (int level = 0; level < levels; level++) {
+            size_t levelWidth = width >> level > 1 ? width >> level : 1;
+            size_t levelHeight = height >> level > 1 ? height >> level : 1;
+            texels += levelWidth * levelHeight;
+        }
+        return texels * depth * (samples > 1 ? samples : 1) * bytesPerTexel(internalFormat);
+    }
+
+    void setGpuMemoryBudget(size_t bytes) {
+        Registry& memory = registry();
+        memory.totalBudget = bytes;
+        checkBudget(memory.total, bytes, memory.totalOverBudget, "total");
+    }
+
+    void setGpuMemoryBudget(GpuMemoryCategory category, size_t bytes) {
+        Registry& memory = registry();
+        memory.categoryBudgets[category] = bytes;
+        checkBudget(memory.categoryTotals[category], bytes, memory.categoryOverBudget[category], categoryNames[category]);
+    }
+
+    bool isGpuMemoryOverBudget() {
+        const Registry& memory = registry();
+        if (memory.totalBudget > 0 && memory.total > memory.totalBudget)
+            return true;
+        for (int category = 0; category < GPU_MEMORY_CATEGORY_COUNT; category++) {
+            if (memory.categoryBudgets[category] > 0 && memory.categoryTotals[category] > memory.categoryBudgets[category])
+                return true;
+        }
+        return false;
+    }
+
+    size_t getGpuMemoryTotal() {
+        return registry().total;
+    }
+
+    size_t getGpuMemoryTotal(GpuMemoryCategory category) {
+        return registry().categoryTotals[category];
+    }
+
+    const char* getGpuMemoryCategoryName(GpuMemoryCategory category) {
+        return categoryNames[category];
+    }
+
+    template <typename Key>
+    static void addUsage(std::map<std::string, GpuMemoryUsage>& usage, const std::map<Key, Allocation>& allocations) {
+        for (typename std::map<Key, Allocation>::const_iterator it = allocations.begin(); it != allocations.end(); ++it) {
+            std::map<std::string, GpuMemoryUsage>::iterator entry = usage.find(it->second.asset);
+            if (entry == usage.end()) {
+                GpuMemoryUsage empty = GpuMemoryUsage();
+                empty.asset = it->second.asset;
+                entry = usage.insert(std::make_pair(it->second.asset, empty)).first;
+            }
+            entry->second.bytes[it->second.category] += it->second.bytes;
+            entry->second.total += it->second.bytes;
+        }
+    }
+
+    static bool largerFirst(const GpuMemoryUsage& a, const GpuMemoryUsage& b) {
+        return a.total > b.total;
+    }
+
+    std::vector<GpuMemoryUsage> getGpuMemoryByAsset() {
+        const Registry& memory = registry();
+        std::map<std::string, GpuMemoryUsage> usage;
+        addUsage(usage, memory.buffers);
+        addUsage(usage, memory.textures);
+        addUsage(usage, memory.surfaces);
+
+        std::vector<GpuMemoryUsage> assets;
+        assets.reserve(usage.size());
+        for (std::map<std::string, GpuMemoryUsage>::const_iterator it = usage.begin(); it != usage.end(); ++it)
+            assets.push_back(it->second);
+        std::stable_sort(assets.begin(), assets.end(), largerFirst);
+        return assets;
+    }
+
+    void printGpuMemoryReport() {
+        const Registry& memory = registry();
+        printf("GPU memory: %.2f MB in %u buffers, %u textures and %u surfaces\n", megabytes(memory.total),
+            (unsigned int)memory.buffers.size(), (unsigned int)memory.textures.size(), (unsigned int)memory.surfaces.size());
+        for (int category = 0; category < GPU_MEMORY_CATEGORY_COUNT; category++) {
+            printf("  %-14s %9.2f MB", categoryNames[category], megabytes(memory.categoryTotals[category]));
+            if (memory.categoryBudgets[category] > 0)
+                printf(" of %.2f MB", megabytes(memory.categoryBudgets[category]));
+            printf("\n");
+        }
+        if (memory.totalBudget > 0)
+            printf("  budget         %9.2f MB\n", megabytes(memory.totalBudget));
+
+        std::vector<GpuMemoryUsage> assets = getGpuMemoryByAsset();
+        for (size_t i = 0; i < assets.size(); i++) {
+            printf("  %9.2f MB  %s (", megabytes(assets[i].total), assets[i].asset.c_str());
+            const char* separator = "";
+            for (int category = 0; category < GPU_MEMORY_CATEGORY_COUNT; category++) {
+                if (assets[i].bytes[category] == 0)
+                    continue;
+                printf("%s%s %.2f", separator, categoryNames[category], megabytes(assets[i].bytes[category]));
+                separator = ", ";
+            }
+            printf(")\n");
+        }
+
+        // both report kB
+        if (GLEW_NVX_gpu_memory_info) {
+            GLint dedicated = 0, available = 0;
+            glGetIntegerv(GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX, &dedicated);
+            glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &available);
+            printf("  driver: %.0f MB of %.0f MB video memory free\n", available / 1024.0, dedicated / 1024.0);
+        }
+        else if (GLEW_ATI_meminfo) {
+            // total free, largest free block, total and largest free auxiliary memory
+            GLint textureFree[4] = { 0 };
+            glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, textureFree);
+            printf("  driver: %.0f MB texture memory free\n", textureFree[0] / 1024.0);
+        }
+    }
+
+    GpuMemoryScope::GpuMemoryScope(const std::string& asset) : previous(registry().currentAsset) {
+        registry().currentAsset = asset;
+    }
+
+    GpuMemoryScope::~GpuMemoryScope() {
+        registry().currentAsset = previous;
+    }
+}
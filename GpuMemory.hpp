@@ -0,0 +1,82 @@
+#ifndef GpuMemory_hpp
+#define GpuMemory_hpp
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    enum GpuMemoryCategory {
+        // vertex and index buffers
+        GPU_MEMORY_GEOMETRY,
+        GPU_MEMORY_TEXTURES,
+        // uniform and storage buffers
+        GPU_MEMORY_SHADER_DATA,
+        // rewritten every frame
+        GPU_MEMORY_STREAMING,
+        // render targets and their MSAA samples
+        GPU_MEMORY_FRAMEBUFFERS,
+        GPU_MEMORY_CATEGORY_COUNT
+    };
+
+    // Bytes one asset holds, per category
+    struct GpuMemoryUsage {
+        std::string asset;
+        size_t bytes[GPU_MEMORY_CATEGORY_COUNT];
+        size_t total;
+    };
+
+    // GPU memory registry
+    //
+    // Every buffer and texture records the size of its storage here when it gets one, and the
+    // GLHandle traits drop the record when the object is deleted. A record belongs to the asset
+    // of the innermost GpuMemoryScope, or to the asset named when tracking. The sizes are what
+    // the storage needs, drivers may round up or pad. GL thread only, like the objects.
+
+    // Records the storage of an object, replacing an earlier record of it; asset NULL is the
+    // asset of the current scope. False if a budget is exceeded now
+    bool trackBufferMemory(GLuint buffer, size_t bytes, GpuMemoryCategory category, const char* asset = NULL);
+    bool trackTextureMemory(GLuint texture, size_t bytes, GpuMemoryCategory category, const char* asset = NULL);
+    // Storage that is not a GL object, like the default framebuffer, recorded under name
+    bool trackSurfaceMemory(const std::string& name, size_t bytes, GpuMemoryCategory category, const char* asset = NULL);
+    void untrackBufferMemory(GLuint buffer);
+    void untrackTextureMemory(GLuint texture);
+
+    // Bytes of a texture with levels mip levels (0 for the full chain), depth layers or faces
+    // and samples per texel
+    size_t textureStorageBytes(GLenum internalFormat, int width, int height, int depth, int levels, int samples);
+
+    // 0 bytes is no budget; over a budget a warning is printed once
+    void setGpuMemoryBudget(size_t bytes);
+    void setGpuMemoryBudget(GpuMemoryCategory category, size_t bytes);
+    bool isGpuMemoryOverBudget();
+
+    size_t getGpuMemoryTotal();
+    size_t getGpuMemoryTotal(GpuMemoryCategory category);
+    // every asset holding memory, the largest first
+    std::vector<GpuMemoryUsage> getGpuMemoryByAsset();
+    const char* getGpuMemoryCategoryName(GpuMemoryCategory category);
+
+    // Totals per category and per asset, and what the driver says is free where it can tell
+    // (NVX_gpu_memory_info or ATI_meminfo)
+    void printGpuMemoryReport();
+
+    // Attributes the memory tracked while it exists to asset
+    class GpuMemoryScope
+    {
+    public:
+        explicit GpuMemoryScope(const std::string& asset);
+        ~GpuMemoryScope();
+
+        GpuMemoryScope(const GpuMemoryScope&) = delete;
+        GpuMemoryScope& operator=(const GpuMemoryScope&) = delete;
+
+    private:
+        std::string previous;
+    };
+}
+
+#endif /* GpuMemory_hpp */
@@ -0,0 +1,293 @@
+#include "GpuProfiler.hpp"
+#include "GLDebug.hpp"
+#include "RenderStats.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace gps {
+
+    // frame budget the overlay bars are measured against, 60 fps
+    static const float OVERLAY_BUDGET = 1000.0f / 60.0f;
+    static const float OVERLAY_ROW_HEIGHT = 14.0f;
+    static const float OVERLAY_BAR_HEIGHT = 10.0f;
+    static const float OVERLAY_INDENT = 10.0f;
+
+    static const float overlayColors[][3] = {
+        { 0.90f, 0.30f, 0.25f },
+        { 0.30f, 0.75f, 0.30f },
+        { 0.30f, 0.50f, 0.95f },
+        { 0.95f, 0.75f, 0.20f },
+        { 0.70f, 0.35f, 0.90f },
+        { 0.20f, 0.80f, 0.85f },
+        { 0.95f, 0.50f, 0.70f },
+        { 0.60f, 0.60f, 0.60f }
+    };
+
+    GpuProfiler::GpuProfiler()
+        : frame(0), historyNext(0), historyCount(0), droppedFrames(0), viewportSizeLoc(-1) {
+        for (int i = 0; i < FRAME_LATENCY; i++) {
+            frames[i].used = 0;
+            frames[i].lastIssued = 0;
+            frames[i].frame = 0;
+        }
+        memset(historyFrames, 0, sizeof(historyFrames));
+    }
+
+    void GpuProfiler::init() {
+        overlayShader.loadShader("shaders/profilerOverlay.vert", "shaders/profilerOverlay.frag");
+        viewportSizeLoc = glGetUniformLocation(overlayShader.shaderProgram.get(), "viewportSize");
+
+        overlayVAO = GLVertexArray::create();
+        overlayVBO = GLBuffer::create();
+        glBindVertexArray(overlayVAO.get());
+        glBindBuffer(GL_ARRAY_BUFFER, overlayVBO.get());
+        // pixel position, color
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (GLvoid*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (GLvoid*)(2 * sizeof(float)));
+        glBindVertexArray(0);
+        setObjectLabel(GL_VERTEX_ARRAY, overlayVAO.get(), "profiler overlay VAO");
+        setObjectLabel(GL_BUFFER, overlayVBO.get(), "profiler overlay vertices");
+    }
+
+    void GpuProfiler::beginFrame() {
+        frame++;
+        FrameQueries& queries = frames[frame % FRAME_LATENCY];
+        resolve(queries);
+        queries.used = 0;
+        queries.markers.clear();
+        queries.lastIssued = 0;
+        queries.frame = frame;
+        openMarkers.clear();
+    }
+
+    void GpuProfiler::endFrame() {
+        // a scope left open has no end timestamp, close it here so the frame still resolves
+        while (!openMarkers.empty())
+            endScope();
+    }
+
+    void GpuProfiler::beginScope(const char* name) {
+        FrameQueries& queries = frames[frame % FRAME_LATENCY];
+        Marker marker;
+        marker.scope = findScope(name);
+        marker.begin = takeQuery(queries);
+        marker.end = takeQuery(queries);
+        glQueryCounter(marker.begin, GL_TIMESTAMP);
+        openMarkers.push_back(queries.markers.size());
+        queries.markers.push_back(marker);
+        // every scope is a debug group too, so capture tools show the same passes
+        pushDebugGroup(name);
+    }
+
+    void GpuProfiler::endScope() {
+        if (openMarkers.empty())
+            return;
+        FrameQueries& queries = frames[frame % FRAME_LATENCY];
+        popDebugGroup();
+        glQueryCounter(queries.markers[openMarkers.back()].end, GL_TIMESTAMP);
+        queries.lastIssued = queries.markers[openMarkers.back()].end;
+        openMarkers.pop_back();
+    }
+
+    GLuint GpuProfiler::takeQuery(FrameQueries& queries) {
+        if (queries.used == queries.pool.size())
+            queries.pool.push_back(GLQuery::create());
+        return queries.pool[queries.used++].get();
+    }
+
+    size_t GpuProfiler::findScope(const char* name) {
+        for (size_t i = 0; i < scopes.size(); i++) {
+            if (scopes[i].name == name || strcmp(scopes[i].name, name) == 0)
+                return i;
+        }
+
+        Scope scope;
+        scope.name = name;
+        scope.depth = (int)openMarkers.size();
+        scope.history.assign(HISTORY_SIZE, 0.0f);
+        scopes.push_back(scope);
+        return scopes.size() - 1;
+    }
+
+    void GpuProfiler::resolve(FrameQueries& queries) {
+        if (queries.lastIssued == 0)
+            return;
+
+        // timestamps complete in order, so once the last one written is there the whole frame is
+        // that is not the end of the last scope opened, an outer scope ends after the ones inside it
+        GLint available = 0;
+        glGetQueryObjectiv(queries.lastIssued, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            droppedFrames++;
+            return;
+        }
+
+        for (size_t i = 0; i < scopes.size(); i++)
+            scopes[i].history[historyNext] = 0.0f;
+        for (size_t i = 0; i < queries.markers.size(); i++) {
+            const Marker& marker = queries.markers[i];
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(marker.begin, GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(marker.end, GL_QUERY_RESULT, &end);
+            scopes[marker.scope].history[historyNext] += (float)((end - begin) / 1.0e6);
+        }
+
+        historyFrames[historyNext] = queries.frame;
+        historyNext = (historyNext + 1) % HISTORY_SIZE;
+        if (historyCount < HISTORY_SIZE)
+            historyCount++;
+    }
+
+    size_t GpuProfiler::getScopeCount() const {
+        return scopes.size();
+    }
+
+    GpuScopeStats GpuProfiler::getScopeStats(size_t scope) const {
+        const Scope& s = scopes[scope];
+        GpuScopeStats stats = GpuScopeStats();
+        stats.name = s.name;
+        stats.depth = s.depth;
+        if (historyCount == 0)
+            return stats;
+
+        float total = 0.0f;
+        for (size_t i = 0; i < historyCount; i++) {
+            float time = s.history[(historyNext + HISTORY_SIZE - 1 - i) % HISTORY_SIZE];
+            total += time;
+            if (time > stats.max)
+                stats.max = time;
+        }
+        stats.last = s.history[(historyNext + HISTORY_SIZE - 1) % HISTORY_SIZE];
+        stats.average = total / historyCount;
+        return stats;
+    }
+
+    unsigned int GpuProfiler::getResolvedFrames() const {
+        return (unsigned int)historyCount;
+    }
+
+    unsigned int GpuProfiler::getDroppedFrames() const {
+        return droppedFrames;
+    }
+
+    unsigned int GpuProfiler::getFrame() const {
+        return frame;
+    }
+
+    bool GpuProfiler::getLastResolved(const char* name, unsigned int& resolvedFrame, float& time) const {
+        if (historyCount == 0)
+            return false;
+        size_t last = (historyNext + HISTORY_SIZE - 1) % HISTORY_SIZE;
+        for (size_t i = 0; i < scopes.size(); i++) {
+            if (strcmp(scopes[i].name, name) == 0) {
+                resolvedFrame = historyFrames[last];
+                time = scopes[i].history[last];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void GpuProfiler::addRect(float x0, float y0, float x1, float y1, float r, float g, float b) {
+        // counter clockwise once y points up, so face culling keeps them
+        const float corners[6][2] = { { x0, y0 }, { x1, y1 }, { x1, y0 }, { x0, y0 }, { x0, y1 }, { x1, y1 } };
+        for (int i = 0; i < 6; i++) {
+            overlayVertices.push_back(corners[i][0]);
+            overlayVertices.push_back(corners[i][1]);
+            overlayVertices.push_back(r);
+            overlayVertices.push_back(g);
+            overlayVertices.push_back(b);
+        }
+    }
+
+    void GpuProfiler::drawOverlay(int width, int height) {
+        if (scopes.empty() || !overlayVAO)
+            return;
+
+        const float left = 10.0f, top = 10.0f;
+        float scale = width * 0.5f / OVERLAY_BUDGET;
+        size_t colorCount = sizeof(overlayColors) / sizeof(overlayColors[0]);
+
+        overlayVertices.clear();
+        for (size_t i = 0; i < scopes.size(); i++) {
+            GpuScopeStats stats = getScopeStats(i);
+            const float* color = overlayColors[i % colorCount];
+            float x = left + stats.depth * OVERLAY_INDENT;
+            float y = top + i * OVERLAY_ROW_HEIGHT;
+            addRect(x, y, x + stats.max * scale, y + OVERLAY_BAR_HEIGHT, color[0] * 0.4f, color[1] * 0.4f, color[2] * 0.4f);
+            addRect(x, y, x + stats.average * scale, y + OVERLAY_BAR_HEIGHT, color[0], color[1], color[2]);
+        }
+        float budgetX = left + OVERLAY_BUDGET * scale;
+        addRect(budgetX, top - 2.0f, budgetX + 1.0f, top + scopes.size() * OVERLAY_ROW_HEIGHT, 1.0f, 1.0f, 1.0f);
+
+        GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+        glDisable(GL_DEPTH_TEST);
+        overlayShader.useShaderProgram();
+        glUniform2f(viewportSizeLoc, (float)width, (float)height);
+        glBindVertexArray(overlayVAO.get());
+        glBindBuffer(GL_ARRAY_BUFFER, overlayVBO.get());
+        glBufferData(GL_ARRAY_BUFFER, overlayVertices.size() * sizeof(float), overlayVertices.data(), GL_STREAM_DRAW);
+        glDrawArrays(GL_TRIANGLES, 0, (GLsizei)(overlayVertices.size() / 5));
+        countProgramBind();
+        countUniformBytes(2 * sizeof(float));
+        countVaoBind();
+        countBufferUpload(overlayVertices.size() * sizeof(float));
+        trackBufferMemory(overlayVBO.get(), overlayVertices.size() * sizeof(float), GPU_MEMORY_STREAMING, "gpu profiler");
+        countDraw(GL_TRIANGLES, (GLsizei)(overlayVertices.size() / 5));
+        glBindVertexArray(0);
+        if (depthTest)
+            glEnable(GL_DEPTH_TEST);
+    }
+
+    bool GpuProfiler::writeCsv(const std::string& fileName) const {
+        FILE* file = fopen(fileName.c_str(), "w");
+        if (!file) {
+            std::cerr << "Could not write GPU profile " << fileName << std::endl;
+            return false;
+        }
+
+        fprintf(file, "frame");
+        for (size_t s = 0; s < scopes.size(); s++)
+            fprintf(file, ",%s", scopes[s].name);
+        fprintf(file, "\n");
+
+        // oldest frame first
+        for (size_t i = 0; i < historyCount; i++) {
+            size_t h = (historyNext + HISTORY_SIZE - historyCount + i) % HISTORY_SIZE;
+            fprintf(file, "%u", historyFrames[h]);
+            for (size_t s = 0; s < scopes.size(); s++)
+                fprintf(file, ",%.4f", scopes[s].history[h]);
+            fprintf(file, "\n");
+        }
+        fclose(file);
+        return true;
+    }
+
+    bool GpuProfiler::writeJson(const std::string& fileName) const {
+        FILE* file = fopen(fileName.c_str(), "w");
+        if (!file) {
+            std::cerr << "Could not write GPU profile " << fileName << std::endl;
+            return false;
+        }
+
+        fprintf(file, "{\n  \"resolvedFrames\": %u,\n  \"droppedFrames\": %u,\n  \"scopes\": [\n",
+            (unsigned int)historyCount, droppedFrames);
+        for (size_t s = 0; s < scopes.size(); s++) {
+            GpuScopeStats stats = getScopeStats(s);
+            fprintf(file, "    { \"name\": \"%s\", \"depth\": %d, \"last\": %.4f, \"average\": %.4f, \"max\": %.4f, \"history\": [",
+                stats.name, stats.depth, stats.last, stats.average, stats.max);
+            for (size_t i = 0; i < historyCount; i++) {
+                size_t h = (historyNext + HISTORY_SIZE - historyCount + i) % HISTORY_SIZE;
+                fprintf(file, i == 0 ? "%.4f" : ", %.4f", scopes[s].history[h]);
+            }
+            fprintf(file, s + 1 < scopes.size() ? "] },\n" : "] }\n");
+        }
+        fprintf(file, "  ]\n}\n");
+        fclose(file);
+        return true;
+    }
+}
@@ -0,0 +1,137 @@
+#ifndef GpuProfiler_hpp
+#define GpuProfiler_hpp
+
+#include <GL/glew.h>
+
+#include "Shader.hpp"
+#include "GLResource.hpp"
+
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    // GPU time of one named scope over the frames in the history, in ms
+    struct GpuScopeStats {
+        const char* name;
+        // nesting level, 0 for scopes opened outside any other
+        int depth;
+        float last;
+        float average;
+        float max;
+    };
+
+    // GPU timings of named scopes, from GL_TIMESTAMP queries
+    //
+    // Every scope writes a timestamp when it opens and one when it closes. The queries of a frame
+    // come from a pool that is only reused FRAME_LATENCY frames later, and are read back then, so
+    // reading them never waits for the GPU; a frame whose queries are still not done is dropped.
+    // Scopes may nest, a scope used several times in a frame adds up. Each scope keeps the last
+    // HISTORY_SIZE frames, they can be drawn as an overlay or written to CSV or JSON.
+    // Every scope is also a GL debug group, so capture tools show the same breakdown.
+    class GpuProfiler
+    {
+    public:
+        static const int FRAME_LATENCY = 4;
+        static const int HISTORY_SIZE = 240;
+
+        GpuProfiler();
+        GpuProfiler(GpuProfiler&&) = default;
+        GpuProfiler& operator=(GpuProfiler&&) = default;
+        GpuProfiler(const GpuProfiler&) = delete;
+        GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+        // Loads the overlay shader
+        void init();
+
+        // Reads back the oldest frame in flight and starts a new one
+        void beginFrame();
+        void endFrame();
+
+        // name must outlive the profiler, scopes are told apart by name
+        void beginScope(const char* name);
+        void endScope();
+
+        size_t getScopeCount() const;
+        GpuScopeStats getScopeStats(size_t scope) const;
+        // frames read back so far and frames whose queries weren't done in time
+        unsigned int getResolvedFrames() const;
+        unsigned int getDroppedFrames() const;
+        // number of the frame beginFrame() started last, counting from 1
+        unsigned int getFrame() const;
+        // The newest frame read back and the time of the scope name in it, false if there is none
+        bool getLastResolved(const char* name, unsigned int& resolvedFrame, float& time) const;
+
+        // One bar per scope in the top left corner, the length is the average time against a
+        // 60 fps frame (the tick), the dark part behind it goes up to the max
+        void drawOverlay(int width, int height);
+
+        // CSV: one row per frame of the history, one column per scope
+        // JSON: the stats of every scope and its history
+        // Both print the reason and return false when the file can't be written
+        bool writeCsv(const std::string& fileName) const;
+        bool writeJson(const std::string& fileName) const;
+
+    private:
+        // timestamps around one use of a scope
+        struct Marker {
+            size_t scope;
+            GLuint begin;
+            GLuint end;
+        };
+
+        struct FrameQueries {
+            std::vector<GLQuery> pool;
+            size_t used;
+            std::vector<Marker> markers;
+            // the timestamp written last, the end of the outermost scope closed last
+            GLuint lastIssued;
+            unsigned int frame;
+        };
+
+        struct Scope {
+            const char* name;
+            int depth;
+            // ms per history frame, a ring indexed like historyFrames
+            std::vector<float> history;
+        };
+
+        FrameQueries frames[FRAME_LATENCY];
+        unsigned int frame;
+        // markers of the scopes open right now, innermost last
+        std::vector<size_t> openMarkers;
+
+        std::vector<Scope> scopes;
+        unsigned int historyFrames[HISTORY_SIZE];
+        size_t historyNext;
+        size_t historyCount;
+        unsigned int droppedFrames;
+
+        Shader overlayShader;
+        GLint viewportSizeLoc;
+        GLVertexArray overlayVAO;
+        GLBuffer overlayVBO;
+        std::vector<float> overlayVertices;
+
+        GLuint takeQuery(FrameQueries& queries);
+        size_t findScope(const char* name);
+        void resolve(FrameQueries& queries);
+        void addRect(float x0, float y0, float x1, float y1, float r, float g, float b);
+    };
+
+    // Times the GPU work issued while it exists
+    class GpuProfileScope
+    {
+    public:
+        GpuProfileScope(GpuProfiler& profiler, const char* name) : profiler(profiler) { profiler.beginScope(name); }
+        ~GpuProfileScope() { profiler.endScope(); }
+
+        GpuProfileScope(const GpuProfileScope&) = delete;
+        GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+    private:
+        GpuProfiler& profiler;
+    };
+}
+
+#endif /* GpuProfiler_hpp */
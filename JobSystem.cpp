@@ -0,0 +1,197 @@
+#include "JobSystem.hpp"
+
+#include <algorithm>
+
+namespace gps {
+
+    // system whose worker the current thread is, and its index there
+    static thread_local const JobSystem* currentSystem = NULL;
+    static thread_local unsigned int currentThread = 0;
+
+    JobSystem::JobSystem() : queuedJobs(0), sleepingWorkers(0), stopping(false),
+        beginHook(NULL), endHook(NULL), hookUserData(NULL) {
+        queues.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+        resetStats();
+    }
+
+    JobSystem::~JobSystem() {
+        stop();
+    }
+
+    void JobSystem::start(unsigned int workerCount) {
+        stop();
+
+        if (workerCount == 0) {
+            unsigned int hardwareThreads = std::thread::hardware_concurrency();
+            workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+        }
+
+        queues.clear();
+        for (unsigned int i = 0; i <= workerCount; i++)
+            queues.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+        resetStats();
+
+        stopping = false;
+        for (unsigned int i = 1; i <= workerCount; i++)
+            workers.push_back(std::thread(&JobSystem::workerLoop, this, i));
+    }
+
+    void JobSystem::stop() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        for (size_t i = 0; i < workers.size(); i++)
+            workers[i].join();
+        workers.clear();
+    }
+
+    unsigned int JobSystem::getThreadCount() const {
+        return (unsigned int)workers.size() + 1;
+    }
+
+    unsigned int JobSystem::getThreadIndex() const {
+        return currentSystem == this ? currentThread : 0;
+    }
+
+    void JobSystem::run(const char* name, std::function<void()> work, JobCounter& counter) {
+        unsigned int thread = getThreadIndex();
+
+        Job job;
+        job.work = std::move(work);
+        job.counter = &counter;
+        job.name = name;
+        job.queue = thread;
+        counter.pending.fetch_add(1, std::memory_order_relaxed);
+
+        WorkerQueue& queue = *queues[thread];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.jobs.push_back(std::move(job));
+        }
+
+        // a worker going to sleep either sees the new job or is counted here, never neither
+        queuedJobs.fetch_add(1);
+        if (sleepingWorkers.load() > 0) {
+            { std::lock_guard<std::mutex> lock(sleepMutex); }
+            wakeUp.notify_one();
+        }
+    }
+
+    bool JobSystem::tryGetJob(unsigned int thread, Job& job) {
+        // newest job of our own queue first
+        {
+            WorkerQueue& queue = *queues[thread];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.jobs.empty()) {
+                job = std::move(queue.jobs.back());
+                queue.jobs.pop_back();
+                queuedJobs.fetch_sub(1);
+                return true;
+            }
+        }
+
+        // then the oldest job of someone else
+        unsigned int queueCount = (unsigned int)queues.size();
+        for (unsigned int i = 1; i < queueCount; i++) {
+            WorkerQueue& victim = *queues[(thread + i) % queueCount];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.jobs.empty()) {
+                job = std::move(victim.jobs.front());
+                victim.jobs.pop_front();
+                queuedJobs.fetch_sub(1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void JobSystem::execute(Job& job, unsigned int thread) {
+        if (beginHook != NULL)
+            beginHook(job.name, thread, hookUserData);
+        job.work();
+        if (endHook != NULL)
+            endHook(job.name, thread, hookUserData);
+
+        WorkerQueue& queue = *queues[thread];
+        queue.executed.fetch_add(1, std::memory_order_relaxed);
+        if (job.queue != thread)
+            queue.stolen.fetch_add(1, std::memory_order_relaxed);
+
+        job.counter->pending.fetch_sub(1, std::memory_order_release);
+    }
+
+    void JobSystem::wait(JobCounter& counter) {
+        unsigned int thread = getThreadIndex();
+        while (!counter.isDone()) {
+            Job job;
+            if (tryGetJob(thread, job))
+                execute(job, thread);
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    void JobSystem::workerLoop(unsigned int thread) {
+        currentSystem = this;
+        currentThread = thread;
+
+        while (true) {
+            Job job;
+            if (tryGetJob(thread, job)) {
+                execute(job, thread);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleepingWorkers.fetch_add(1);
+            wakeUp.wait(lock, [this] { return queuedJobs.load() > 0 || stopping; });
+            sleepingWorkers.fetch_sub(1);
+            if (stopping)
+                break;
+        }
+
+        currentSystem = NULL;
+        currentThread = 0;
+    }
+
+    void JobSystem::parallelFor(const char* name, size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& body) {
+        if (count == 0)
+            return;
+        grainSize = std::max<size_t>(grainSize, 1);
+        if (count <= grainSize) {
+            body(0, count);
+            return;
+        }
+
+        JobCounter counter;
+        for (size_t begin = 0; begin < count; begin += grainSize) {
+            size_t end = std::min(count, begin + grainSize);
+            run(name, [&body, begin, end]() { body(begin, end); }, counter);
+        }
+        wait(counter);
+    }
+
+    void JobSystem::setProfileHooks(JobHook onBegin, JobHook onEnd, void* userData) {
+        beginHook = onBegin;
+        endHook = onEnd;
+        hookUserData = userData;
+    }
+
+    JobStats JobSystem::getStats() const {
+        JobStats stats = { 0, 0 };
+        for (size_t i = 0; i < queues.size(); i++) {
+            stats.executed += queues[i]->executed.load(std::memory_order_relaxed);
+            stats.stolen += queues[i]->stolen.load(std::memory_order_relaxed);
+        }
+        return stats;
+    }
+
+    void JobSystem::resetStats() {
+        for (size_t i = 0; i < queues.size(); i++) {
+            queues[i]->executed.store(0, std::memory_order_relaxed);
+            queues[i]->stolen.store(0, std::memory_order_relaxed);
+        }
+    }
+}
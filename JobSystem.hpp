@@ -0,0 +1,115 @@
+#ifndef JobSystem_hpp
+#define JobSystem_hpp
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gps {
+
+    // Number of jobs still running under it; JobSystem::wait returns once it drops to 0
+    class JobCounter
+    {
+    public:
+        JobCounter() : pending(0) {}
+        JobCounter(const JobCounter&) = delete;
+        JobCounter& operator=(const JobCounter&) = delete;
+
+        bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+
+    private:
+        friend class JobSystem;
+        std::atomic<int> pending;
+    };
+
+    // Called around every job with its name and the thread running it (0 is the thread that waits)
+    typedef void (*JobHook)(const char* name, unsigned int thread, void* userData);
+
+    struct JobStats {
+        unsigned long long executed;
+        // executed by another thread than the one that queued them
+        unsigned long long stolen;
+    };
+
+    // Work stealing job system
+    //
+    // Every thread has its own deque of jobs: it pushes and pops at the back, so it keeps working
+    // on what it queued last while its caches are warm, and idle threads steal the oldest jobs from
+    // the front of the others. A thread that waits on a counter keeps running jobs until the
+    // counter is done, that is how work continues after its children (no fibers: a waiting job
+    // keeps its stack). Threads that are not workers share queue 0.
+    class JobSystem
+    {
+    public:
+        JobSystem();
+        ~JobSystem();
+
+        JobSystem(const JobSystem&) = delete;
+        JobSystem& operator=(const JobSystem&) = delete;
+
+        // Starts the worker threads, 0 starts one per hardware thread besides the caller
+        // Without workers every job runs on the thread that waits for it
+        void start(unsigned int workerCount);
+        // Joins the workers, nothing may be running
+        void stop();
+
+        // Workers plus the thread that waits
+        unsigned int getThreadCount() const;
+
+        // Queues work on the calling thread's deque; name must outlive the job (a literal)
+        void run(const char* name, std::function<void()> work, JobCounter& counter);
+        // Runs jobs until counter is done
+        void wait(JobCounter& counter);
+
+        // Calls body(begin, end) over [0, count) in chunks of grainSize items and returns when all are done
+        void parallelFor(const char* name, size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& body);
+
+        // Profiling hooks, either may be NULL; set them while no job is running
+        void setProfileHooks(JobHook onBegin, JobHook onEnd, void* userData);
+
+        JobStats getStats() const;
+        void resetStats();
+
+    private:
+        struct Job {
+            std::function<void()> work;
+            JobCounter* counter;
+            const char* name;
+            unsigned int queue;
+        };
+
+        struct WorkerQueue {
+            std::mutex mutex;
+            std::deque<Job> jobs;
+            std::atomic<unsigned long long> executed;
+            std::atomic<unsigned long long> stolen;
+        };
+
+        unsigned int getThreadIndex() const;
+        bool tryGetJob(unsigned int thread, Job& job);
+        void execute(Job& job, unsigned int thread);
+        void workerLoop(unsigned int thread);
+
+        std::vector<std::unique_ptr<WorkerQueue>> queues;
+        std::vector<std::thread> workers;
+
+        // jobs in all the queues, workers sleep while it is 0
+        std::atomic<int> queuedJobs;
+        std::atomic<int> sleepingWorkers;
+        std::mutex sleepMutex;
+        std::condition_variable wakeUp;
+        bool stopping;
+
+        JobHook beginHook;
+        JobHook endHook;
+        void* hookUserData;
+    };
+}
+
+#endif /* JobSystem_hpp */
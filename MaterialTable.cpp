@@ -0,0 +1,71 @@
+#include "MaterialTable.hpp"
+#include "GLDebug.hpp"
+#include "RenderStats.hpp"
+
+#include <cstring>
+#include <iostream>
+
+namespace gps {
+
+    static MaterialData packMaterial(const Material& material) {
+        MaterialData data;
+        data.ambient = glm::vec4(material.ambient, 1.0f);
+        data.diffuse = glm::vec4(material.diffuse, 1.0f);
+        data.specular = glm::vec4(material.specular, material.shininess);
+        return data;
+    }
+
+    MaterialTable::MaterialTable() {
+        // matches the constants the basic shader used before materials were read
+        // the shaders scale ambient by their ambient strength, so Ka stays as the .mtl files give it
+        Material defaultMaterial;
+        defaultMaterial.ambient = glm::vec3(1.0f);
+        defaultMaterial.diffuse = glm::vec3(1.0f);
+        defaultMaterial.specular = glm::vec3(0.5f);
+        defaultMaterial.shininess = 32.0f;
+        materials.push_back(packMaterial(defaultMaterial));
+    }
+
+    GLuint MaterialTable::add(const Material& material) {
+        MaterialData data = packMaterial(material);
+
+        for (GLuint i = 0; i < materials.size(); i++) {
+            if (memcmp(&materials[i], &data, sizeof(MaterialData)) == 0)
+                return i;
+        }
+
+        if (materials.size() >= MAX_MATERIALS) {
+            std::cerr << "WARNING: material table is full, using the default material" << std::endl;
+            return DEFAULT_MATERIAL;
+        }
+
+        materials.push_back(data);
+        return (GLuint)materials.size() - 1;
+    }
+
+    GLuint MaterialTable::size() const {
+        return (GLuint)materials.size();
+    }
+
+    void MaterialTable::upload() {
+        if (!buffer)
+            buffer = GLBuffer::create();
+
+        // the block is declared with MAX_MATERIALS entries, so the buffer has to be that large
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer.get());
+        glBufferData(GL_UNIFORM_BUFFER, MAX_MATERIALS * sizeof(MaterialData), NULL, GL_STATIC_DRAW);
+        trackBufferMemory(buffer.get(), MAX_MATERIALS * sizeof(MaterialData), GPU_MEMORY_SHADER_DATA, "material table");
+        setObjectLabel(GL_BUFFER, buffer.get(), "material table");
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, materials.size() * sizeof(MaterialData), &materials[0]);
+        countBufferUpload(materials.size() * sizeof(MaterialData));
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+        glBindBufferBase(GL_UNIFORM_BUFFER, BINDING_POINT, buffer.get());
+    }
+
+    void MaterialTable::attachShader(const Shader& shader) {
+        GLuint blockIndex = glGetUniformBlockIndex(shader.shaderProgram.get(), "MaterialBlock");
+        if (blockIndex != GL_INVALID_INDEX)
+            glUniformBlockBinding(shader.shaderProgram.get(), blockIndex, BINDING_POINT);
+    }
+}
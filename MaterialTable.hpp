@@ -0,0 +1,51 @@
+#ifndef MaterialTable_hpp
+#define MaterialTable_hpp
+
+#include <GL/glew.h>
+#include "glm/glm.hpp"
+
+#include "Mesh.hpp"
+#include "Shader.hpp"
+#include "GLResource.hpp"
+
+#include <vector>
+
+namespace gps {
+
+    // One entry of the table, std140 layout
+    struct MaterialData {
+        glm::vec4 ambient;  // rgb
+        glm::vec4 diffuse;  // rgb
+        glm::vec4 specular; // rgb, a = shininess
+    };
+
+    // The materials of all the loaded models, packed in a single uniform buffer
+    // Draws pick their entry by material ID, so switching materials uploads no uniforms
+    class MaterialTable
+    {
+    public:
+        // Must match the array size of MaterialBlock in the shaders
+        static const GLuint MAX_MATERIALS = 256;
+        static const GLuint BINDING_POINT = 0;
+        // ID of the material used by meshes that do not have one
+        static const GLuint DEFAULT_MATERIAL = 0;
+
+        MaterialTable();
+
+        // Adds a material and returns its ID, identical materials share the same ID
+        GLuint add(const Material& material);
+        GLuint size() const;
+
+        // Uploads the table to the uniform buffer and binds it to BINDING_POINT
+        void upload();
+
+        // Connects the MaterialBlock of a shader to the table
+        static void attachShader(const Shader& shader);
+
+    private:
+        std::vector<MaterialData> materials;
+        GLBuffer buffer;
+    };
+}
+
+#endif /* MaterialTable_hpp */
@@ -1,59 +1,165 @@
 #include "Mesh.hpp"
+#include "GeometryArena.hpp"
+#include "GLDebug.hpp"
+#include "RenderStats.hpp"
 namespace gps {
 
+	const char* TextureSlotNames[TEXTURE_SLOT_COUNT] = { "ambientTexture", "diffuseTexture", "specularTexture" };
+
+	static int getTextureSlot(const std::string& type) {
+		for (int slot = 0; slot < TEXTURE_SLOT_COUNT; slot++) {
+			if (type == TextureSlotNames[slot])
+				return slot;
+		}
+		return -1;
+	}
+
 	/* Mesh Constructor */
-	Mesh::Mesh(std::vector<Vertex> vertices, std::vector<GLuint> indices, std::vector<Texture> textures)
+	Mesh::Mesh(std::vector<Vertex>&& vertices, std::vector<GLuint>&& indices, std::vector<Texture>&& textures, bool keepGeometry)
+		: vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)),
+		  materialIndex(-1), materialId(0)
 	{
-		this->vertices = vertices;
-		this->indices = indices;
-		this->textures = textures;
-
 		this->setupMesh();
+
+		if (!keepGeometry)
+			this->releaseGeometry();
+	}
+
+	Mesh::Mesh(std::vector<Vertex>&& vertices, std::vector<GLuint>&& indices, std::vector<Texture>&& textures, GeometryArena& arena, bool keepGeometry)
+		: vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)),
+		  materialIndex(-1), materialId(0)
+	{
+		this->computeBounds();
+
+		ArenaRange range = arena.add(this->vertices, this->indices);
+		this->drawVAO = arena.getVAO();
+		this->indexOffset = range.firstIndex * sizeof(GLuint);
+		this->baseVertex = range.baseVertex;
+		this->indexCount = range.indexCount;
+		this->indexType = GL_UNSIGNED_INT;
+
+		if (!keepGeometry)
+			this->releaseGeometry();
+	}
+
+	Buffers Mesh::getBuffers() const {
+		Buffers buffers;
+		buffers.VAO = this->VAO.get();
+		buffers.VBO = this->VBO.get();
+		buffers.EBO = this->EBO.get();
+	    return buffers;
+	}
+
+	const Bounds& Mesh::getBounds() const {
+		return this->bounds;
 	}
 
-	Buffers Mesh::getBuffers() {
-	    return this->buffers;
+	DrawPacket Mesh::getDrawPacket() const {
+		DrawPacket packet;
+		packet.VAO = this->drawVAO;
+		packet.indexOffset = this->indexOffset;
+		packet.baseVertex = this->baseVertex;
+		packet.indexCount = this->indexCount;
+		packet.indexType = this->indexType;
+		packet.materialId = this->materialId;
+
+		for (int slot = 0; slot < TEXTURE_SLOT_COUNT; slot++)
+			packet.textures[slot] = 0;
+		for (size_t i = 0; i < this->textures.size(); i++) {
+			int slot = getTextureSlot(this->textures[i].type);
+			if (slot != -1)
+				packet.textures[slot] = this->textures[i].id;
+		}
+
+		return packet;
+	}
+
+	void Mesh::releaseGeometry() {
+		std::vector<Vertex>().swap(this->vertices);
+		std::vector<GLuint>().swap(this->indices);
 	}
 
 	/* Mesh drawing function - also applies associated textures */
-	void Mesh::Draw(gps::Shader shader)
+	void Mesh::Draw(const gps::Shader& shader)
 	{
 		shader.useShaderProgram();
+		countProgramBind();
 
 		//set textures
 		for (GLuint i = 0; i < textures.size(); i++)
 		{
 			glActiveTexture(GL_TEXTURE0 + i);
-			glUniform1i(glGetUniformLocation(shader.shaderProgram, this->textures[i].type.c_str()), i);
+			glUniform1i(glGetUniformLocation(shader.shaderProgram.get(), this->textures[i].type.c_str()), i);
 			glBindTexture(GL_TEXTURE_2D, this->textures[i].id);
 		}
+		countUniformBytes(this->textures.size() * sizeof(GLint));
+		countTextureBinds((unsigned int)this->textures.size());
+
+		glVertexAttribI1ui(MATERIAL_ID_ATTRIBUTE, this->materialId);
 
-		glBindVertexArray(this->buffers.VAO);
-		glDrawElements(GL_TRIANGLES, this->indices.size(), GL_UNSIGNED_INT, 0);
+		glBindVertexArray(this->drawVAO);
+		glDrawElementsBaseVertex(GL_TRIANGLES, this->indexCount, this->indexType, (GLvoid*)(uintptr_t)this->indexOffset, this->baseVertex);
 		glBindVertexArray(0);
+		countVaoBind();
+		countDraw(GL_TRIANGLES, this->indexCount);
 
         for(GLuint i = 0; i < this->textures.size(); i++)
         {
             glActiveTexture(GL_TEXTURE0 + i);
             glBindTexture(GL_TEXTURE_2D, 0);
         }
+        countTextureBinds((unsigned int)this->textures.size());
 
     }
 
+	// bounds are computed while the vertices are still around
+	void Mesh::computeBounds() {
+		this->bounds.min = this->bounds.max = this->vertices.empty() ? glm::vec3(0.0f) : this->vertices[0].Position;
+		for (size_t i = 1; i < this->vertices.size(); i++) {
+			this->bounds.min = glm::min(this->bounds.min, this->vertices[i].Position);
+			this->bounds.max = glm::max(this->bounds.max, this->vertices[i].Position);
+		}
+	}
+
 	// Initializes all the buffer objects/arrays
 	void Mesh::setupMesh(){
+		this->computeBounds();
+
 		// Create buffers/arrays
-		glGenVertexArrays(1, &this->buffers.VAO);
-		glGenBuffers(1, &this->buffers.VBO);
-		glGenBuffers(1, &this->buffers.EBO);
+		this->VAO = GLVertexArray::create();
+		this->drawVAO = this->VAO.get();
+		this->indexOffset = 0;
+		this->baseVertex = 0;
+		this->VBO = GLBuffer::create();
+		this->EBO = GLBuffer::create();
 
-		glBindVertexArray(this->buffers.VAO);
+		glBindVertexArray(this->VAO.get());
 		// Load data into vertex buffers
-		glBindBuffer(GL_ARRAY_BUFFER, this->buffers.VBO);
+		glBindBuffer(GL_ARRAY_BUFFER, this->VBO.get());
 		glBufferData(GL_ARRAY_BUFFER, this->vertices.size() * sizeof(Vertex), &this->vertices[0], GL_STATIC_DRAW);
+		countBufferUpload(this->vertices.size() * sizeof(Vertex));
+		trackBufferMemory(this->VBO.get(), this->vertices.size() * sizeof(Vertex), GPU_MEMORY_GEOMETRY);
+
+		// 16 bit indices are enough for most meshes and halve the index fetch bandwidth
+		this->indexCount = (GLsizei)this->indices.size();
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->EBO.get());
+		if (this->vertices.size() <= 0xFFFF) {
+			std::vector<GLushort> shortIndices(this->indices.begin(), this->indices.end());
+			this->indexType = GL_UNSIGNED_SHORT;
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(GLushort), &shortIndices[0], GL_STATIC_DRAW);
+			countBufferUpload(shortIndices.size() * sizeof(GLushort));
+			trackBufferMemory(this->EBO.get(), shortIndices.size() * sizeof(GLushort), GPU_MEMORY_GEOMETRY);
+		}
+		else {
+			this->indexType = GL_UNSIGNED_INT;
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->indices.size() * sizeof(GLuint), &this->indices[0], GL_STATIC_DRAW);
+			countBufferUpload(this->indices.size() * sizeof(GLuint));
+			trackBufferMemory(this->EBO.get(), this->indices.size() * sizeof(GLuint), GPU_MEMORY_GEOMETRY);
+		}
 
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->buffers.EBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->indices.size() * sizeof(GLuint), &this->indices[0], GL_STATIC_DRAW);
+		setObjectLabel(GL_VERTEX_ARRAY, this->VAO.get(), "mesh VAO");
+		setObjectLabel(GL_BUFFER, this->VBO.get(), "mesh vertices");
+		setObjectLabel(GL_BUFFER, this->EBO.get(), "mesh indices");
 
 		// Set the vertex attribute pointers
 		// Vertex Positions
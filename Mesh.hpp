@@ -5,6 +5,7 @@
 #include "glm/glm.hpp"
 
 #include "Shader.hpp"
+#include "GLResource.hpp"
 
 #include <string>
 #include <vector>
@@ -12,6 +13,8 @@
 
 namespace gps {
 
+class GeometryArena;
+
 struct Vertex
 {
     glm::vec3 Position;
@@ -32,30 +35,97 @@ struct Material
         glm::vec3 ambient;
         glm::vec3 diffuse;
         glm::vec3 specular;
+        float shininess;
     };
 
+// Axis aligned bounding box, in model space
+struct Bounds {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
 struct Buffers {
     GLuint VAO;
     GLuint VBO;
     GLuint EBO;
 };
 
+// Texture units used for each texture type, fixed for all the shaders
+enum TextureSlot { AMBIENT_TEXTURE, DIFFUSE_TEXTURE, SPECULAR_TEXTURE, TEXTURE_SLOT_COUNT };
+
+// Sampler uniform names, indexed by TextureSlot
+extern const char* TextureSlotNames[TEXTURE_SLOT_COUNT];
+
+// Generic vertex attribute that carries the material ID of a draw
+// It is never enabled as an array, its constant value is set per draw with glVertexAttribI1ui
+const GLuint MATERIAL_ID_ATTRIBUTE = 3;
+
+// Everything needed to issue the draw call of one mesh, resolved at load time
+// Plain data, so a model can keep its packets in one flat array
+struct DrawPacket {
+    GLuint VAO;
+    GLuint indexOffset; // in bytes
+    GLint baseVertex;   // added to every index, non zero for meshes in a GeometryArena
+    GLsizei indexCount; // vertex count for non indexed draws
+    GLenum indexType;   // GL_NONE for non indexed draws
+    // entry of the MaterialTable used by the draw
+    GLuint materialId;
+    // texture bound to unit i, 0 if the mesh has no texture of that type
+    GLuint textures[TEXTURE_SLOT_COUNT];
+};
+
+// Owns the GPU buffers of one mesh; move-only
 class Mesh
 {
 public:
+    // CPU side geometry, empty after upload unless the mesh was told to keep it
     std::vector<Vertex> vertices;
     std::vector<GLuint> indices;
     std::vector<Texture> textures;
+    // index of the material in the model it belongs to, -1 if it has none
+    int materialIndex;
+    // ID of that material in the MaterialTable
+    GLuint materialId;
+
+	// Takes the data over without copying it, uploads it and then frees
+	// the vertices and indices unless keepGeometry is set
+	Mesh(std::vector<Vertex>&& vertices, std::vector<GLuint>&& indices, std::vector<Texture>&& textures, bool keepGeometry = false);
+
+	// Same, but the geometry is copied into the arena instead of buffers of its own
+	Mesh(std::vector<Vertex>&& vertices, std::vector<GLuint>&& indices, std::vector<Texture>&& textures, GeometryArena& arena, bool keepGeometry = false);
+
+	Mesh(Mesh&&) = default;
+	Mesh& operator=(Mesh&&) = default;
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
+
+	Buffers getBuffers() const;
+
+	const Bounds& getBounds() const;
 
-	Mesh(std::vector<Vertex> vertices, std::vector<GLuint> indices, std::vector<Texture> textures);
+	// Resolves the buffers and textures of the mesh into a draw packet
+	DrawPacket getDrawPacket() const;
 
-	Buffers getBuffers();
+	// Frees the CPU side copy of the geometry, the GPU buffers are kept
+	void releaseGeometry();
 
-	void Draw(gps::Shader shader);
+	void Draw(const gps::Shader& shader);
 
 private:
     /*  Render data  */
-    Buffers buffers;
+    // empty when the mesh lives in an arena
+    GLVertexArray VAO;
+    GLBuffer VBO;
+    GLBuffer EBO;
+    // what draws the mesh, its own VAO or the one of the arena
+    GLuint drawVAO;
+    GLuint indexOffset;
+    GLint baseVertex;
+    GLsizei indexCount;
+    GLenum indexType;
+    Bounds bounds;
+
+	void computeBounds();
 
 	// Initializes all the buffer objects/arrays
 	void setupMesh();
@@ -1,27 +1,143 @@
 #include "Model3D.hpp"
+#include "CpuProfiler.hpp"
+#include "GLDebug.hpp"
+#include "RenderStats.hpp"
+#include "AllocationTracker.hpp"
 
 namespace gps {
 
 	void Model3D::LoadModel(std::string fileName)
+	{
+		LoadModel(fileName, LOAD_DEFAULT);
+	}
+
+	void Model3D::LoadModel(std::string fileName, LoadFlags flags)
 	{
         std::string basePath = fileName.substr(0, fileName.find_last_of('/')) + "/";
-		ReadOBJ(fileName, basePath);
+		LoadModel(fileName, basePath, flags);
 	}
 
     void Model3D::LoadModel(std::string fileName, std::string basePath)
 	{
-		ReadOBJ(fileName, basePath);
+		LoadModel(fileName, basePath, LOAD_DEFAULT);
+	}
+
+    void Model3D::LoadModel(std::string fileName, std::string basePath, LoadFlags flags)
+	{
+		ReadOBJ(fileName, basePath, flags, NULL);
+		CompileDrawPackets();
+	}
+
+	void Model3D::LoadModel(std::string fileName, GeometryArena& arena)
+	{
+		LoadModel(fileName, arena, LOAD_DEFAULT);
+	}
+
+	void Model3D::LoadModel(std::string fileName, GeometryArena& arena, LoadFlags flags)
+	{
+		std::string basePath = fileName.substr(0, fileName.find_last_of('/')) + "/";
+		ReadOBJ(fileName, basePath, flags, &arena);
+		CompileDrawPackets();
 	}
 
 	// Draw each mesh from the model
-	void Model3D::Draw(gps::Shader shaderProgram)
+	void Model3D::Draw(const gps::Shader& shaderProgram)
 	{
-		for (int i = 0; i < meshes.size(); i++)
-			meshes[i].Draw(shaderProgram);
+		GPS_PROFILE_ZONE("Model3D::Draw");
+		shaderProgram.useShaderProgram();
+
+		// every texture type has its own unit, so the samplers are set once per model
+		for (GLuint slot = 0; slot < TEXTURE_SLOT_COUNT; slot++)
+			glUniform1i(glGetUniformLocation(shaderProgram.shaderProgram.get(), TextureSlotNames[slot]), slot);
+		countProgramBind();
+		countUniformBytes(TEXTURE_SLOT_COUNT * sizeof(GLint));
+
+		GLuint boundVAO = 0;
+		GLuint boundTextures[TEXTURE_SLOT_COUNT] = { 0 };
+		GLuint boundMaterial = GL_INVALID_INDEX;
+
+		for (size_t i = 0; i < drawPackets.size(); i++) {
+			const DrawPacket& packet = drawPackets[i];
+
+			for (GLuint slot = 0; slot < TEXTURE_SLOT_COUNT; slot++) {
+				if (packet.textures[slot] != boundTextures[slot]) {
+					glActiveTexture(GL_TEXTURE0 + slot);
+					glBindTexture(GL_TEXTURE_2D, packet.textures[slot]);
+					boundTextures[slot] = packet.textures[slot];
+					countTextureBinds();
+				}
+			}
+
+			// the material ID is a constant vertex attribute, not a uniform
+			if (packet.materialId != boundMaterial) {
+				glVertexAttribI1ui(MATERIAL_ID_ATTRIBUTE, packet.materialId);
+				boundMaterial = packet.materialId;
+			}
+
+			if (packet.VAO != boundVAO) {
+				glBindVertexArray(packet.VAO);
+				boundVAO = packet.VAO;
+				countVaoBind();
+			}
+
+			glDrawElementsBaseVertex(GL_TRIANGLES, packet.indexCount, packet.indexType, (GLvoid*)(uintptr_t)packet.indexOffset, packet.baseVertex);
+			countDraw(GL_TRIANGLES, packet.indexCount);
+		}
+
+		glBindVertexArray(0);
+
+		for (GLuint slot = 0; slot < TEXTURE_SLOT_COUNT; slot++) {
+			if (boundTextures[slot] != 0) {
+				glActiveTexture(GL_TEXTURE0 + slot);
+				glBindTexture(GL_TEXTURE_2D, 0);
+				countTextureBinds();
+			}
+		}
+	}
+
+	void Model3D::RegisterMaterials(gps::MaterialTable& materialTable)
+	{
+		for (size_t i = 0; i < meshes.size(); i++) {
+			if (meshes[i].materialIndex != -1)
+				meshes[i].materialId = materialTable.add(materials[meshes[i].materialIndex]);
+			else
+				meshes[i].materialId = MaterialTable::DEFAULT_MATERIAL;
+		}
+
+		CompileDrawPackets();
+	}
+
+	const std::vector<gps::DrawPacket>& Model3D::getDrawPackets() const {
+		return drawPackets;
+	}
+
+	const std::vector<gps::Bounds>& Model3D::getMeshBounds() const {
+		return meshBounds;
+	}
+
+	const std::vector<gps::Mesh>& Model3D::getMeshes() const {
+		return meshes;
+	}
+
+	void Model3D::CompileDrawPackets() {
+		GPS_PROFILE_ZONE("Model3D::CompileDrawPackets");
+		drawPackets.clear();
+		drawPackets.reserve(meshes.size());
+		meshBounds.clear();
+		meshBounds.reserve(meshes.size());
+
+		for (size_t i = 0; i < meshes.size(); i++) {
+			drawPackets.push_back(meshes[i].getDrawPacket());
+			meshBounds.push_back(meshes[i].getBounds());
+		}
 	}
 
 	// Does the parsing of the .obj file and fills in the data structure
-	void Model3D::ReadOBJ(std::string fileName, std::string basePath){
+	void Model3D::ReadOBJ(std::string fileName, std::string basePath, LoadFlags flags, GeometryArena* arena){
+		GPS_PROFILE_ZONE("Model3D::ReadOBJ");
+		// buffers and textures made while loading belong to the file
+		GpuMemoryScope memoryScope(fileName);
+		AllocationScope allocationScope(ALLOCATION_LOADER);
 
         std::cout << "Loading : " << fileName << std::endl;
 		tinyobj::attrib_t attrib;
@@ -43,12 +159,32 @@ namespace gps {
 		std::cout << "# of shapes    : " << shapes.size() << std::endl;
 		std::cout << "# of materials : " << materials.size() << std::endl;
 
+		meshes.reserve(meshes.size() + shapes.size());
+
+		// materials of this file start after the ones already read
+		size_t materialOffset = this->materials.size();
+		this->materials.reserve(materialOffset + materials.size());
+		for (size_t m = 0; m < materials.size(); m++) {
+			gps::Material currentMaterial;
+			currentMaterial.ambient = glm::vec3(materials[m].ambient[0], materials[m].ambient[1], materials[m].ambient[2]);
+			currentMaterial.diffuse = glm::vec3(materials[m].diffuse[0], materials[m].diffuse[1], materials[m].diffuse[2]);
+			currentMaterial.specular = glm::vec3(materials[m].specular[0], materials[m].specular[1], materials[m].specular[2]);
+			currentMaterial.shininess = materials[m].shininess;
+			this->materials.push_back(currentMaterial);
+		}
+
 		// Loop over shapes
 		for (size_t s = 0; s < shapes.size(); s++) {
 			std::vector<gps::Vertex> vertices;
 			std::vector<GLuint> indices;
 			std::vector<gps::Texture> textures;
 
+			// every face corner becomes a vertex, so the sizes are known up front
+			vertices.reserve(shapes[s].mesh.indices.size());
+			indices.reserve(shapes[s].mesh.indices.size());
+			// ambient, diffuse and specular at most
+			textures.reserve(3);
+
 			// Loop over faces(polygon)
 			size_t index_offset = 0;
 			for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
@@ -95,13 +231,11 @@ namespace gps {
 			// get material id
 			// Only try to read materials if the .mtl file is present
 			int a = shapes[s].mesh.material_ids.size();
+			int meshMaterialIndex = -1;
 			if (a > 0 && materials.size()>0) {
 				materialId = shapes[s].mesh.material_ids[0];
 				if (materialId != -1) {
-					gps::Material currentMaterial;
-					currentMaterial.ambient = glm::vec3(materials[materialId].ambient[0], materials[materialId].ambient[1], materials[materialId].ambient[2]);
-					currentMaterial.diffuse = glm::vec3(materials[materialId].diffuse[0], materials[materialId].diffuse[1], materials[materialId].diffuse[2]);
-					currentMaterial.specular = glm::vec3(materials[materialId].specular[0], materials[materialId].specular[1], materials[materialId].specular[2]);
+					meshMaterialIndex = (int)(materialOffset + materialId);
 
 					//ambient texture
 					std::string ambientTexturePath = materials[materialId].ambient_texname;
@@ -132,7 +266,13 @@ namespace gps {
 				}
 			}
 
-			meshes.push_back(gps::Mesh(vertices, indices, textures));
+			// the mesh takes the vectors over, uploads them and frees them unless asked to keep them
+			bool keepGeometry = (flags & LOAD_KEEP_GEOMETRY) != 0;
+			if (arena)
+				meshes.push_back(gps::Mesh(std::move(vertices), std::move(indices), std::move(textures), *arena, keepGeometry));
+			else
+				meshes.push_back(gps::Mesh(std::move(vertices), std::move(indices), std::move(textures), keepGeometry));
+			meshes.back().materialIndex = meshMaterialIndex;
 		}
 	}
 
@@ -153,12 +293,15 @@ namespace gps {
 			currentTexture.path = path;
 
 			loadedTextures.push_back(currentTexture);
+			textureObjects.push_back(gps::GLTexture(currentTexture.id));
 
 			return currentTexture;
 		}
 
 	// Reads the pixel data from an image file and loads it into the video memory
 	GLuint Model3D::ReadTextureFromFile(const char* file_name) {
+		GPS_PROFILE_ZONE("Model3D::ReadTextureFromFile");
+		AllocationScope allocationScope(ALLOCATION_TEXTURES);
 		int x, y, n;
 		int force_channels = 4;
 		unsigned char* image_data = stbi_load(file_name, &x, &y, &n, force_channels);
@@ -194,6 +337,7 @@ namespace gps {
 		GLuint textureID;
 		glGenTextures(1, &textureID);
 		glBindTexture(GL_TEXTURE_2D, textureID);
+		setObjectLabel(GL_TEXTURE, textureID, file_name);
 		glTexImage2D(
 			GL_TEXTURE_2D,
 			0,
@@ -205,6 +349,9 @@ namespace gps {
 			GL_UNSIGNED_BYTE,
 			image_data
 		);
+		// the mip levels are made on the GPU, only the base level crosses the bus
+		countTextureUpload((size_t)x * y * 4);
+		trackTextureMemory(textureID, textureStorageBytes(GL_SRGB8, x, y, 1, 0, 1), GPU_MEMORY_TEXTURES);
 		glGenerateMipmap(GL_TEXTURE_2D);
 
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -213,21 +360,8 @@ namespace gps {
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 		glBindTexture(GL_TEXTURE_2D, 0);
 
-		return textureID;
-	}
+		stbi_image_free(image_data);
 
-	Model3D::~Model3D() {
-        for (size_t i = 0; i < loadedTextures.size(); i++) {
-            glDeleteTextures(1, &loadedTextures.at(i).id);
-        }
-
-        for (size_t i = 0; i < meshes.size(); i++) {
-            GLuint VBO = meshes.at(i).getBuffers().VBO;
-            GLuint EBO = meshes.at(i).getBuffers().EBO;
-            GLuint VAO = meshes.at(i).getBuffers().VAO;
-            glDeleteBuffers(1, &VBO);
-            glDeleteBuffers(1, &EBO);
-            glDeleteVertexArrays(1, &VAO);
-        }
+		return textureID;
 	}
 }
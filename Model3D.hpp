@@ -2,6 +2,8 @@
 #define Model3D_hpp
 
 #include "Mesh.hpp"
+#include "MaterialTable.hpp"
+#include "GeometryArena.hpp"
 
 #include "tiny_obj_loader.h"
 #include "stb_image.h"
@@ -12,26 +14,69 @@
 
 namespace gps {
 
+    // Options for Model3D::LoadModel
+    enum LoadFlags {
+        LOAD_DEFAULT = 0,
+        // keep the CPU side vertices and indices of every mesh after they are uploaded
+        LOAD_KEEP_GEOMETRY = 1
+    };
+
+    // Owns the meshes and textures of a loaded model; move-only
     class Model3D
     {
 
     public:
-        ~Model3D();
+        Model3D() {}
+        Model3D(Model3D&&) = default;
+        Model3D& operator=(Model3D&&) = default;
+        Model3D(const Model3D&) = delete;
+        Model3D& operator=(const Model3D&) = delete;
 
 		void LoadModel(std::string fileName);
 
+		void LoadModel(std::string fileName, LoadFlags flags);
+
 		void LoadModel(std::string fileName, std::string basePath);
 
-		void Draw(gps::Shader shaderProgram);
+		void LoadModel(std::string fileName, std::string basePath, LoadFlags flags);
+
+		// Loads the meshes into a shared arena instead of buffers of their own
+		void LoadModel(std::string fileName, GeometryArena& arena);
+
+		void LoadModel(std::string fileName, GeometryArena& arena, LoadFlags flags);
+
+		// Adds the materials of the model to the table and points the meshes at their entries
+		void RegisterMaterials(gps::MaterialTable& materialTable);
+
+		void Draw(const gps::Shader& shaderProgram);
+
+		const std::vector<gps::DrawPacket>& getDrawPackets() const;
+
+		// Model space bounds of each mesh, parallel to the draw packets
+		const std::vector<gps::Bounds>& getMeshBounds() const;
+
+		// Geometry is only available if the model was loaded with LOAD_KEEP_GEOMETRY
+		const std::vector<gps::Mesh>& getMeshes() const;
 
     private:
+		// One packet per mesh - the only data walked when drawing
+        std::vector<gps::DrawPacket> drawPackets;
+        std::vector<gps::Bounds> meshBounds;
 		// Component meshes - group of objects
         std::vector<gps::Mesh> meshes;
+		// Materials read from the .mtl file, indexed by Mesh::materialIndex
+        std::vector<gps::Material> materials;
 		// Associated textures
         std::vector<gps::Texture> loadedTextures;
+		// GL objects of loadedTextures, released with the model
+        std::vector<gps::GLTexture> textureObjects;
 
 		// Does the parsing of the .obj file and fills in the data structure
-		void ReadOBJ(std::string fileName, std::string basePath);
+		// Meshes go to the arena when there is one
+		void ReadOBJ(std::string fileName, std::string basePath, LoadFlags flags, GeometryArena* arena);
+
+		// Builds the draw packets of the meshes
+		void CompileDrawPackets();
 
 		// Retrieves a texture associated with the object - by its name and type
 		gps::Texture LoadTexture(std::string path, std::string type);
@@ -0,0 +1,371 @@
+#include "OcclusionCulling.hpp"
+#include "FrameArena.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GPS_RASTER_SSE2
+#endif
+
+namespace gps {
+
+    // bands smaller than this are not worth a job
+    static const int MIN_ROWS_PER_JOB = 16;
+
+    OcclusionCuller::OcclusionCuller() : width(0), height(0), jobs(NULL), viewProjection(1.0f) {
+        setResolution(256, 128);
+    }
+
+    void OcclusionCuller::setResolution(int width, int height) {
+        this->width = (std::max(width, 4) + 3) & ~3;
+        this->height = std::max(height, 1);
+
+        levels.clear();
+        levelWidths.clear();
+        levelHeights.clear();
+
+        int levelWidth = this->width;
+        int levelHeight = this->height;
+        while (true) {
+            levels.push_back(std::vector<float>(levelWidth * levelHeight, 1.0f));
+            levelWidths.push_back(levelWidth);
+            levelHeights.push_back(levelHeight);
+            if (levelWidth == 1 && levelHeight == 1)
+                break;
+            levelWidth = (levelWidth + 1) / 2;
+            levelHeight = (levelHeight + 1) / 2;
+        }
+    }
+
+    int OcclusionCuller::getWidth() const {
+        return width;
+    }
+
+    int OcclusionCuller::getHeight() const {
+        return height;
+    }
+
+    void OcclusionCuller::setJobSystem(JobSystem* jobs) {
+        this->jobs = jobs;
+    }
+
+    void OcclusionCuller::clearOccluders() {
+        occluders.clear();
+    }
+
+    size_t OcclusionCuller::addOccluder(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, const glm::mat4& world) {
+        Occluder occluder;
+        occluder.positions = positions;
+        occluder.indices = indices;
+        occluder.world = world;
+        occluders.push_back(occluder);
+        return occluders.size() - 1;
+    }
+
+    void OcclusionCuller::setOccluderTransform(size_t index, const glm::mat4& world) {
+        occluders[index].world = world;
+    }
+
+    size_t OcclusionCuller::getOccluderCount() const {
+        return occluders.size();
+    }
+
+    const std::vector<float>& OcclusionCuller::getDepthBuffer() const {
+        return levels[0];
+    }
+
+    size_t OcclusionCuller::getLevelCount() const {
+        return levels.size();
+    }
+
+    const std::vector<float>& OcclusionCuller::getLevel(size_t level) const {
+        return levels[level];
+    }
+
+    int OcclusionCuller::getLevelWidth(size_t level) const {
+        return levelWidths[level];
+    }
+
+    int OcclusionCuller::getLevelHeight(size_t level) const {
+        return levelHeights[level];
+    }
+
+    const glm::mat4& OcclusionCuller::getViewProjection() const {
+        return viewProjection;
+    }
+
+    size_t OcclusionCuller::getTriangleCount() const {
+        return triangles.size();
+    }
+
+    void OcclusionCuller::render(const glm::mat4& viewProjection) {
+        this->viewProjection = viewProjection;
+        setupTriangles();
+
+        std::vector<float>& depth = levels[0];
+        std::fill(depth.begin(), depth.end(), 1.0f);
+
+        if (jobs == NULL) {
+            rasterizeRows(0, height);
+        }
+        else {
+            // every job owns a horizontal band of the buffer, so no two jobs write the same pixel
+            int bands = (int)jobs->getThreadCount();
+            bands = std::max(1, std::min(bands, height / MIN_ROWS_PER_JOB));
+            int rowsPerBand = (height + bands - 1) / bands;
+            jobs->parallelFor("occlusion raster", height, rowsPerBand, [this](size_t minY, size_t maxY) {
+                rasterizeRows((int)minY, (int)maxY);
+            });
+        }
+
+        buildPyramid();
+    }
+
+    void OcclusionCuller::setupTriangles() {
+        triangles.clear();
+
+        for (size_t o = 0; o < occluders.size(); o++) {
+            const Occluder& occluder = occluders[o];
+            glm::mat4 transform = viewProjection * occluder.world;
+
+            // from the frame arena when culling for a frame, each occluder gives it back to the next
+            FrameVector<glm::vec4> clip(occluder.positions.size());
+            for (size_t i = 0; i < clip.size(); i++)
+                clip[i] = transform * glm::vec4(occluder.positions[i], 1.0f);
+
+            for (size_t i = 0; i + 2 < occluder.indices.size(); i += 3)
+                clipTriangle(clip[occluder.indices[i]], clip[occluder.indices[i + 1]], clip[occluder.indices[i + 2]]);
+        }
+    }
+
+    // clips against the near plane (z >= -w); the other planes are handled by the screen bounds
+    void OcclusionCuller::clipTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c) {
+        const glm::vec4 input[3] = { a, b, c };
+        float distance[3];
+        int inside = 0;
+        for (int i = 0; i < 3; i++) {
+            distance[i] = input[i].z + input[i].w;
+            if (distance[i] >= 0.0f)
+                inside++;
+        }
+
+        if (inside == 0)
+            return;
+        if (inside == 3) {
+            addTriangle(a, b, c);
+            return;
+        }
+
+        glm::vec4 output[4];
+        int count = 0;
+        for (int i = 0; i < 3; i++) {
+            int next = (i + 1) % 3;
+            if (distance[i] >= 0.0f)
+                output[count++] = input[i];
+            if ((distance[i] >= 0.0f) != (distance[next] >= 0.0f)) {
+                float t = distance[i] / (distance[i] - distance[next]);
+                output[count++] = input[i] + (input[next] - input[i]) * t;
+            }
+        }
+
+        for (int i = 1; i + 1 < count; i++)
+            addTriangle(output[0], output[i], output[i + 1]);
+    }
+
+    void OcclusionCuller::addTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c) {
+        const glm::vec4* clip[3] = { &a, &b, &c };
+        ScreenTriangle triangle;
+        float z[3];
+        for (int i = 0; i < 3; i++) {
+            float w = std::max(clip[i]->w, 1.0e-6f);
+            triangle.x[i] = (clip[i]->x / w * 0.5f + 0.5f) * width;
+            triangle.y[i] = (clip[i]->y / w * 0.5f + 0.5f) * height;
+            z[i] = clip[i]->z / w * 0.5f + 0.5f;
+        }
+
+        // fully off screen
+        if (std::max(std::max(triangle.x[0], triangle.x[1]), triangle.x[2]) < 0.0f ||
+            std::min(std::min(triangle.x[0], triangle.x[1]), triangle.x[2]) > (float)width ||
+            std::max(std::max(triangle.y[0], triangle.y[1]), triangle.y[2]) < 0.0f ||
+            std::min(std::min(triangle.y[0], triangle.y[1]), triangle.y[2]) > (float)height)
+            return;
+
+        // occluders are drawn from both sides, so make every triangle counter clockwise
+        float area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) -
+                     (triangle.y[1] - triangle.y[0]) * (triangle.x[2] - triangle.x[0]);
+        if (std::fabs(area) < 1.0e-6f)
+            return;
+        if (area < 0.0f) {
+            std::swap(triangle.x[1], triangle.x[2]);
+            std::swap(triangle.y[1], triangle.y[2]);
+            std::swap(z[1], z[2]);
+            area = -area;
+        }
+
+        // depth is affine in screen space: z = zA * x + zB * y + zC
+        float dx1 = triangle.x[1] - triangle.x[0], dy1 = triangle.y[1] - triangle.y[0];
+        float dx2 = triangle.x[2] - triangle.x[0], dy2 = triangle.y[2] - triangle.y[0];
+        float dz1 = z[1] - z[0], dz2 = z[2] - z[0];
+        triangle.zA = (dz1 * dy2 - dz2 * dy1) / area;
+        triangle.zB = (dz2 * dx1 - dz1 * dx2) / area;
+        triangle.zC = z[0] - triangle.zA * triangle.x[0] - triangle.zB * triangle.y[0];
+
+        triangles.push_back(triangle);
+    }
+
+    void OcclusionCuller::rasterizeRows(int minY, int maxY) {
+        std::vector<float>& depth = levels[0];
+
+        for (size_t t = 0; t < triangles.size(); t++) {
+            const ScreenTriangle& triangle = triangles[t];
+
+            int x0 = std::max(0, (int)std::floor(std::min(std::min(triangle.x[0], triangle.x[1]), triangle.x[2])));
+            int x1 = std::min(width - 1, (int)std::ceil(std::max(std::max(triangle.x[0], triangle.x[1]), triangle.x[2])));
+            int y0 = std::max(minY, (int)std::floor(std::min(std::min(triangle.y[0], triangle.y[1]), triangle.y[2])));
+            int y1 = std::min(maxY - 1, (int)std::ceil(std::max(std::max(triangle.y[0], triangle.y[1]), triangle.y[2])));
+            if (x0 > x1 || y0 > y1)
+                continue;
+
+            // edge i is opposite to vertex i, e(x, y) = a * x + b * y + c is >= 0 inside
+            float a[3], b[3], c[3];
+            for (int i = 0; i < 3; i++) {
+                int from = (i + 1) % 3;
+                int to = (i + 2) % 3;
+                a[i] = triangle.y[from] - triangle.y[to];
+                b[i] = triangle.x[to] - triangle.x[from];
+                c[i] = -a[i] * triangle.x[from] - b[i] * triangle.y[from];
+            }
+
+            // 4 pixels at a time, rows are a multiple of 4 wide
+            int startX = x0 & ~3;
+            for (int y = y0; y <= y1; y++) {
+                float py = y + 0.5f;
+                float* row = &depth[y * width];
+#if defined(GPS_RASTER_SSE2)
+                __m128 px = _mm_add_ps(_mm_set1_ps(startX + 0.5f), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+                __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[0]), px), _mm_set1_ps(b[0] * py + c[0]));
+                __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[1]), px), _mm_set1_ps(b[1] * py + c[1]));
+                __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[2]), px), _mm_set1_ps(b[2] * py + c[2]));
+                __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.zA), px), _mm_set1_ps(triangle.zB * py + triangle.zC));
+                __m128 step0 = _mm_set1_ps(a[0] * 4.0f);
+                __m128 step1 = _mm_set1_ps(a[1] * 4.0f);
+                __m128 step2 = _mm_set1_ps(a[2] * 4.0f);
+                __m128 stepZ = _mm_set1_ps(triangle.zA * 4.0f);
+                __m128 zero = _mm_setzero_ps();
+
+                for (int x = startX; x <= x1; x += 4) {
+                    __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+                    __m128 old = _mm_loadu_ps(row + x);
+                    __m128 mask = _mm_and_ps(inside, _mm_cmplt_ps(z, old));
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(mask, z), _mm_andnot_ps(mask, old)));
+
+                    e0 = _mm_add_ps(e0, step0);
+                    e1 = _mm_add_ps(e1, step1);
+                    e2 = _mm_add_ps(e2, step2);
+                    z = _mm_add_ps(z, stepZ);
+                }
+#else
+                for (int x = startX; x <= x1; x++) {
+                    float px = x + 0.5f;
+                    if (a[0] * px + b[0] * py + c[0] < 0.0f ||
+                        a[1] * px + b[1] * py + c[1] < 0.0f ||
+                        a[2] * px + b[2] * py + c[2] < 0.0f)
+                        continue;
+                    float z = triangle.zA * px + triangle.zB * py + triangle.zC;
+                    if (z < row[x])
+                        row[x] = z;
+                }
+#endif
+            }
+        }
+    }
+
+    void OcclusionCuller::buildPyramid() {
+        for (size_t level = 1; level < levels.size(); level++) {
+            const std::vector<float>& below = levels[level - 1];
+            int belowWidth = levelWidths[level - 1];
+            int belowHeight = levelHeights[level - 1];
+            std::vector<float>& current = levels[level];
+
+            for (int y = 0; y < levelHeights[level]; y++) {
+                int y0 = y * 2;
+                int y1 = std::min(y0 + 1, belowHeight - 1);
+                for (int x = 0; x < levelWidths[level]; x++) {
+                    int x0 = x * 2;
+                    int x1 = std::min(x0 + 1, belowWidth - 1);
+                    current[y * levelWidths[level] + x] = std::max(
+                        std::max(below[y0 * belowWidth + x0], below[y0 * belowWidth + x1]),
+                        std::max(below[y1 * belowWidth + x0], below[y1 * belowWidth + x1]));
+                }
+            }
+        }
+    }
+
+    bool OcclusionCuller::isVisible(const glm::vec3& center, const glm::vec3& extent) const {
+        float minX = 1.0e30f, minY = 1.0e30f, minZ = 1.0e30f;
+        float maxX = -1.0e30f, maxY = -1.0e30f;
+
+        for (int i = 0; i < 8; i++) {
+            glm::vec3 corner = center + glm::vec3(i & 1 ? extent.x : -extent.x,
+                                                  i & 2 ? extent.y : -extent.y,
+                                                  i & 4 ? extent.z : -extent.z);
+            glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+            // crosses the near plane, nothing can be in front of it
+            if (clip.z < -clip.w || clip.w <= 0.0f)
+                return true;
+
+            float x = (clip.x / clip.w * 0.5f + 0.5f) * width;
+            float y = (clip.y / clip.w * 0.5f + 0.5f) * height;
+            float z = clip.z / clip.w * 0.5f + 0.5f;
+            minX = std::min(minX, x);
+            maxX = std::max(maxX, x);
+            minY = std::min(minY, y);
+            maxY = std::max(maxY, y);
+            minZ = std::min(minZ, z);
+        }
+
+        // not on screen, that is for the frustum culling to decide
+        if (maxX < 0.0f || maxY < 0.0f || minX >= (float)width || minY >= (float)height)
+            return true;
+
+        int x0 = std::max(0, (int)minX);
+        int x1 = std::min(width - 1, (int)maxX);
+        int y0 = std::max(0, (int)minY);
+        int y1 = std::min(height - 1, (int)maxY);
+
+        // go up the pyramid until the box covers at most 2x2 texels
+        size_t level = 0;
+        while ((x1 - x0 > 1 || y1 - y0 > 1) && level + 1 < levels.size()) {
+            x0 >>= 1;
+            x1 >>= 1;
+            y0 >>= 1;
+            y1 >>= 1;
+            level++;
+        }
+
+        const std::vector<float>& depth = levels[level];
+        int levelWidth = levelWidths[level];
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) {
+                if (minZ <= depth[y * levelWidth + x])
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    size_t OcclusionCuller::cull(const BoundsSoA& bounds, std::vector<uint32_t>& visible) const {
+        size_t kept = 0;
+        for (size_t i = 0; i < visible.size(); i++) {
+            uint32_t index = visible[i];
+            if (isVisible(bounds.getCenter(index), bounds.getExtent(index)))
+                visible[kept++] = index;
+        }
+
+        size_t removed = visible.size() - kept;
+        visible.resize(kept);
+        return removed;
+    }
+}
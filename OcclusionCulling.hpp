@@ -0,0 +1,88 @@
+#ifndef OcclusionCulling_hpp
+#define OcclusionCulling_hpp
+
+#include "glm/glm.hpp"
+
+#include "FrustumCulling.hpp"
+#include "JobSystem.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace gps {
+
+    // CPU occlusion culling: a few large occluders are rasterized into a small depth buffer,
+    // a max depth (hierarchical z) pyramid is built from it and bounding boxes are tested
+    // against the pyramid before they are submitted. Nothing here touches the GPU.
+    class OcclusionCuller
+    {
+    public:
+        OcclusionCuller();
+
+        // Size of the depth buffer, the width is rounded up to a multiple of 4
+        void setResolution(int width, int height);
+        int getWidth() const;
+        int getHeight() const;
+
+        // Rasterizes horizontal bands in parallel on jobs, NULL rasterizes on the calling thread
+        void setJobSystem(JobSystem* jobs);
+
+        void clearOccluders();
+        // Positions are in model space, indices form a triangle list; returns the occluder index
+        size_t addOccluder(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, const glm::mat4& world);
+        void setOccluderTransform(size_t index, const glm::mat4& world);
+        size_t getOccluderCount() const;
+
+        // Rasterizes the occluders seen through viewProjection and rebuilds the pyramid
+        void render(const glm::mat4& viewProjection);
+
+        // False only if the world space box is hidden behind the occluders of the last render
+        bool isVisible(const glm::vec3& center, const glm::vec3& extent) const;
+
+        // Removes the occluded boxes from a list of indices into bounds, returns how many were removed
+        size_t cull(const BoundsSoA& bounds, std::vector<uint32_t>& visible) const;
+
+        // Depth buffer of the last render, bottom row first, depths in [0, 1]
+        const std::vector<float>& getDepthBuffer() const;
+
+        // Max depth pyramid of the last render, level 0 is the depth buffer
+        size_t getLevelCount() const;
+        const std::vector<float>& getLevel(size_t level) const;
+        int getLevelWidth(size_t level) const;
+        int getLevelHeight(size_t level) const;
+        const glm::mat4& getViewProjection() const;
+
+        size_t getTriangleCount() const;
+
+    private:
+        struct Occluder {
+            std::vector<glm::vec3> positions;
+            std::vector<uint32_t> indices;
+            glm::mat4 world;
+        };
+
+        // triangle in pixels, with the depth as a plane over the screen
+        struct ScreenTriangle {
+            float x[3], y[3];
+            float zA, zB, zC;
+        };
+
+        void setupTriangles();
+        void clipTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+        void addTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+        void rasterizeRows(int minY, int maxY);
+        void buildPyramid();
+
+        int width, height;
+        JobSystem* jobs;
+        std::vector<Occluder> occluders;
+        std::vector<ScreenTriangle> triangles;
+        glm::mat4 viewProjection;
+
+        // level 0 is the depth buffer, each level above keeps the max depth of 2x2 texels below it
+        std::vector<std::vector<float> > levels;
+        std::vector<int> levelWidths, levelHeights;
+    };
+}
+
+#endif /* OcclusionCulling_hpp */
@@ -0,0 +1,136 @@
+#include "OcclusionQueries.hpp"
+#include "GLDebug.hpp"
+#include "RenderStats.hpp"
+
+#include "glm/gtc/type_ptr.hpp"
+
+namespace gps {
+
+    // boxes are grown a little so flat meshes don't fail the depth test against themselves
+    static const float BOX_SCALE = 1.01f;
+    static const float BOX_PADDING = 0.001f;
+    // a box this close to the camera may be cut by the near plane
+    static const float NEAR_MARGIN = 0.2f;
+
+    OcclusionQueries::OcclusionQueries()
+        : viewProjectionLoc(-1), centerLoc(-1), extentLoc(-1), queryTarget(GL_ANY_SAMPLES_PASSED), frame(0), occludedCount(0)
+    {
+        for (int i = 0; i < POOL_FRAMES; i++)
+            poolUsed[i] = 0;
+    }
+
+    void OcclusionQueries::init() {
+        boxShader.loadShader("shaders/boundingBox.vert", "shaders/boundingBox.frag");
+        viewProjectionLoc = glGetUniformLocation(boxShader.shaderProgram.get(), "viewProjection");
+        centerLoc = glGetUniformLocation(boxShader.shaderProgram.get(), "center");
+        extentLoc = glGetUniformLocation(boxShader.shaderProgram.get(), "extent");
+
+        // the conservative query may answer sooner and never misses a covered pixel
+        queryTarget = (GLEW_VERSION_4_3 || GLEW_ARB_ES3_compatibility) ? GL_ANY_SAMPLES_PASSED_CONSERVATIVE : GL_ANY_SAMPLES_PASSED;
+
+        // unit cube, [-1, 1] on every axis
+        const GLfloat cubeVertices[] = {
+            -1, -1, -1,   1, -1, -1,   1,  1, -1,    1,  1, -1,  -1,  1, -1,  -1, -1, -1,
+            -1, -1,  1,   1, -1,  1,   1,  1,  1,    1,  1,  1,  -1,  1,  1,  -1, -1,  1,
+            -1,  1,  1,  -1,  1, -1,  -1, -1, -1,   -1, -1, -1,  -1, -1,  1,  -1,  1,  1,
+             1,  1,  1,   1,  1, -1,   1, -1, -1,    1, -1, -1,   1, -1,  1,   1,  1,  1,
+            -1, -1, -1,   1, -1, -1,   1, -1,  1,    1, -1,  1,  -1, -1,  1,  -1, -1, -1,
+            -1,  1, -1,   1,  1, -1,   1,  1,  1,    1,  1,  1,  -1,  1,  1,  -1,  1, -1
+        };
+
+        boxVAO = GLVertexArray::create();
+        boxVBO = GLBuffer::create();
+        glBindVertexArray(boxVAO.get());
+        glBindBuffer(GL_ARRAY_BUFFER, boxVBO.get());
+        glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices, GL_STATIC_DRAW);
+        countBufferUpload(sizeof(cubeVertices));
+        trackBufferMemory(boxVBO.get(), sizeof(cubeVertices), GPU_MEMORY_GEOMETRY, "occlusion queries");
+        setObjectLabel(GL_VERTEX_ARRAY, boxVAO.get(), "occlusion box VAO");
+        setObjectLabel(GL_BUFFER, boxVBO.get(), "occlusion box vertices");
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
+        glBindVertexArray(0);
+    }
+
+    void OcclusionQueries::beginFrame(size_t entryCount) {
+        frame++;
+        previousQueries.swap(currentQueries);
+        previousQueries.resize(entryCount, 0);
+        currentQueries.assign(entryCount, 0);
+
+        // the pool of this frame was last used POOL_FRAMES frames ago and its conditional draws
+        // are already queued, count the results that are in without waiting for the others
+        int slot = frame % POOL_FRAMES;
+        occludedCount = 0;
+        for (size_t i = 0; i < poolUsed[slot]; i++) {
+            GLuint available = GL_FALSE;
+            glGetQueryObjectuiv(pools[slot][i].get(), GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                continue;
+            GLuint samplesPassed = 0;
+            glGetQueryObjectuiv(pools[slot][i].get(), GL_QUERY_RESULT, &samplesPassed);
+            if (!samplesPassed)
+                occludedCount++;
+        }
+        poolUsed[slot] = 0;
+    }
+
+    GLuint OcclusionQueries::getCondition(uint32_t entry) const {
+        return entry < previousQueries.size() ? previousQueries[entry] : 0;
+    }
+
+    void OcclusionQueries::issue(const BoundsSoA& bounds, const std::vector<uint32_t>& entries,
+                                 const glm::mat4& viewProjection, const glm::vec3& cameraPosition) {
+        int slot = frame % POOL_FRAMES;
+        std::vector<GLQuery>& pool = pools[slot];
+
+        boxShader.useShaderProgram();
+        glUniformMatrix4fv(viewProjectionLoc, 1, GL_FALSE, glm::value_ptr(viewProjection));
+        glBindVertexArray(boxVAO.get());
+        countProgramBind();
+        countUniformBytes(sizeof(glm::mat4));
+        countVaoBind();
+
+        // the boxes only test the depth buffer, the camera may look at their back faces
+        GLboolean cullFace = glIsEnabled(GL_CULL_FACE);
+        glDisable(GL_CULL_FACE);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_FALSE);
+        glDepthFunc(GL_LEQUAL);
+
+        for (size_t i = 0; i < entries.size(); i++) {
+            uint32_t entry = entries[i];
+            glm::vec3 center = bounds.getCenter(entry);
+            glm::vec3 extent = bounds.getExtent(entry) * BOX_SCALE + glm::vec3(BOX_PADDING);
+
+            glm::vec3 offset = glm::abs(cameraPosition - center);
+            if (offset.x <= extent.x + NEAR_MARGIN && offset.y <= extent.y + NEAR_MARGIN && offset.z <= extent.z + NEAR_MARGIN)
+                continue;
+
+            if (poolUsed[slot] == pool.size())
+                pool.push_back(GLQuery::create());
+            GLuint query = pool[poolUsed[slot]++].get();
+
+            glUniform3fv(centerLoc, 1, glm::value_ptr(center));
+            glUniform3fv(extentLoc, 1, glm::value_ptr(extent));
+            glBeginQuery(queryTarget, query);
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+            glEndQuery(queryTarget);
+            countUniformBytes(2 * sizeof(glm::vec3));
+            countDraw(GL_TRIANGLES, 36);
+
+            currentQueries[entry] = query;
+        }
+
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        if (cullFace)
+            glEnable(GL_CULL_FACE);
+        glBindVertexArray(0);
+    }
+
+    unsigned int OcclusionQueries::getOccludedCount() const {
+        return occludedCount;
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef OcclusionQueries_hpp
+#define OcclusionQueries_hpp
+
+#include <GL/glew.h>
+#include "glm/glm.hpp"
+
+#include "Shader.hpp"
+#include "GLResource.hpp"
+#include "FrustumCulling.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace gps {
+
+    // GPU occlusion culling with hardware queries
+    //
+    // After the scene is drawn, the bounding box of every visible mesh is drawn inside an
+    // occlusion query, with color and depth writes off. The next frame draws each mesh under
+    // glBeginConditionalRender with the query of its box, so the GPU skips what was hidden.
+    // Results are never read back to decide anything, so the CPU never waits for the GPU.
+    class OcclusionQueries
+    {
+    public:
+        // frames a query stays in use: issued in one frame, consumed in the next
+        static const int POOL_FRAMES = 2;
+
+        OcclusionQueries();
+        OcclusionQueries(OcclusionQueries&&) = default;
+        OcclusionQueries& operator=(OcclusionQueries&&) = default;
+        OcclusionQueries(const OcclusionQueries&) = delete;
+        OcclusionQueries& operator=(const OcclusionQueries&) = delete;
+
+        // Loads the bounding box shader and the unit cube
+        void init();
+
+        // Starts a frame for entryCount meshes, the queries of the last frame become the conditions
+        void beginFrame(size_t entryCount);
+
+        // Query of the mesh from the last frame, 0 if there is none and the mesh must be drawn
+        GLuint getCondition(uint32_t entry) const;
+
+        // Draws the boxes of the given meshes inside queries; call after the scene so they test
+        // against its depth. Boxes that contain the camera get no query.
+        void issue(const BoundsSoA& bounds, const std::vector<uint32_t>& entries,
+                   const glm::mat4& viewProjection, const glm::vec3& cameraPosition);
+
+        // Meshes found hidden by the queries that came back, a couple of frames behind
+        unsigned int getOccludedCount() const;
+
+    private:
+        Shader boxShader;
+        GLint viewProjectionLoc;
+        GLint centerLoc;
+        GLint extentLoc;
+        GLVertexArray boxVAO;
+        GLBuffer boxVBO;
+        GLenum queryTarget;
+
+        // queries are recycled, each frame takes them from its own pool
+        std::vector<GLQuery> pools[POOL_FRAMES];
+        size_t poolUsed[POOL_FRAMES];
+        unsigned int frame;
+
+        // query issued for every mesh in this and in the last frame, 0 for none
+        std::vector<GLuint> currentQueries;
+        std::vector<GLuint> previousQueries;
+
+        unsigned int occludedCount;
+    };
+}
+
+#endif /* OcclusionQueries_hpp */
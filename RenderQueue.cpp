@@ -0,0 +1,434 @@
+#include "RenderQueue.hpp"
+#include "GpuProfiler.hpp"
+#include "GLDebug.hpp"
+#include "RenderStats.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <cstring>
+
+namespace gps {
+
+    static const int PASS_BITS = 4;
+    static const int PROGRAM_BITS = 6;
+    static const int MATERIAL_BITS = 10;
+    static const int TEXTURE_SET_BITS = 20;
+    static const int DEPTH_BITS = 24;
+
+    static const int DEPTH_SHIFT = 0;
+    static const int MATERIAL_SHIFT = DEPTH_SHIFT + DEPTH_BITS;
+    static const int TEXTURE_SET_SHIFT = MATERIAL_SHIFT + MATERIAL_BITS;
+    static const int PROGRAM_SHIFT = TEXTURE_SET_SHIFT + TEXTURE_SET_BITS;
+    static const int PASS_SHIFT = PROGRAM_SHIFT + PROGRAM_BITS;
+
+    static uint64_t field(uint64_t value, int bits, int shift) {
+        return (value & ((1ull << bits) - 1)) << shift;
+    }
+
+    // depth func and texture target of each pass
+    struct PassState {
+        GLenum depthFunc;
+        GLenum textureTarget;
+    };
+
+    static const PassState passStates[PASS_COUNT] = {
+        { GL_LESS, GL_TEXTURE_2D },
+        { GL_LEQUAL, GL_TEXTURE_CUBE_MAP }
+    };
+
+    static const char* const passNames[PASS_COUNT] = { "opaque", "sky" };
+
+    // transform and material of a draw, the view matrix is rigid so its inverse transpose is the view rotation
+    static void packDrawData(DrawData& data, const SceneGraph& sceneGraph, NodeId node, const glm::mat3& viewRotation, GLuint materialId) {
+        if (node != NO_PARENT) {
+            data.model = sceneGraph.getWorldMatrix(node);
+            data.normalMatrix = glm::mat4(viewRotation * sceneGraph.getNormalMatrix(node));
+        }
+        else {
+            data.model = glm::mat4(1.0f);
+            data.normalMatrix = glm::mat4(viewRotation);
+        }
+        data.materialId = materialId;
+    }
+
+    RenderCommandList::RenderCommandList() : sceneGraph(NULL), viewRotation(1.0f), maxDepth(1.0f) {
+    }
+
+    void RenderCommandList::begin(const SceneGraph& sceneGraph, const glm::mat4& view, float maxDepth) {
+        clear();
+        this->sceneGraph = &sceneGraph;
+        this->viewRotation = glm::mat3(view);
+        this->maxDepth = maxDepth;
+    }
+
+    void RenderCommandList::clear() {
+        items.clear();
+        keys.clear();
+        drawData.clear();
+    }
+
+    void RenderCommandList::push(RenderPass pass, GLuint programIndex, const DrawPacket& packet, NodeId node, float depth, GLuint condition) {
+        RenderItem item;
+        item.packet = packet;
+        item.programIndex = programIndex;
+        item.node = node;
+        item.condition = condition;
+        items.push_back(item);
+
+        keys.push_back(RenderQueue::makeKey(pass, programIndex, packet, pass == PASS_OPAQUE ? depth / maxDepth : 0.0f));
+
+        drawData.push_back(DrawData());
+        packDrawData(drawData.back(), *sceneGraph, node, viewRotation, packet.materialId);
+    }
+
+    size_t RenderCommandList::size() const {
+        return items.size();
+    }
+
+    RenderQueue::RenderQueue() : maxDepth(1.0f), profiler(NULL) {
+        memset(&stats, 0, sizeof(stats));
+    }
+
+    GLuint RenderQueue::addProgram(const Shader& shader, bool indirect) {
+        RenderProgram program;
+        program.program = shader.shaderProgram.get();
+        program.modelLoc = glGetUniformLocation(program.program, "model");
+        program.normalMatrixLoc = glGetUniformLocation(program.program, "normalMatrix");
+        program.indirect = indirect;
+
+        // units are fixed per texture type, so samplers are set once here and never per draw
+        glUseProgram(program.program);
+        for (GLuint slot = 0; slot < TEXTURE_SLOT_COUNT; slot++)
+            glUniform1i(glGetUniformLocation(program.program, TextureSlotNames[slot]), slot);
+        countProgramBind();
+        countUniformBytes(TEXTURE_SLOT_COUNT * sizeof(GLint));
+
+        programs.push_back(program);
+        return (GLuint)programs.size() - 1;
+    }
+
+    void RenderQueue::setDepthRange(float maxDepth) {
+        this->maxDepth = maxDepth;
+    }
+
+    float RenderQueue::getDepthRange() const {
+        return maxDepth;
+    }
+
+    void RenderQueue::setProfiler(GpuProfiler* profiler) {
+        this->profiler = profiler;
+    }
+
+    void RenderQueue::clear() {
+        items.clear();
+        itemData.clear();
+        pushedItems.clear();
+        entries.clear();
+    }
+
+    void RenderQueue::append(const RenderCommandList& list) {
+        uint32_t base = (uint32_t)items.size();
+        items.insert(items.end(), list.items.begin(), list.items.end());
+        itemData.insert(itemData.end(), list.drawData.begin(), list.drawData.end());
+        for (size_t i = 0; i < list.keys.size(); i++) {
+            SortEntry entry = { list.keys[i], base + (uint32_t)i };
+            entries.push_back(entry);
+        }
+    }
+
+    uint64_t RenderQueue::makeKey(RenderPass pass, GLuint programIndex, const DrawPacket& packet, float normalizedDepth) {
+        // GL texture names are small integers, so 10 bits of the two sampled textures tell
+        // the sets apart in practice; a collision only costs an extra bind, never a wrong draw
+        uint64_t textureSet = ((uint64_t)(packet.textures[DIFFUSE_TEXTURE] & 0x3FF) << 10) |
+                              (packet.textures[SPECULAR_TEXTURE] & 0x3FF);
+        if (pass != PASS_OPAQUE)
+            textureSet = packet.textures[0];
+
+        if (normalizedDepth < 0.0f)
+            normalizedDepth = 0.0f;
+        if (normalizedDepth > 1.0f)
+            normalizedDepth = 1.0f;
+        uint64_t depth = (uint64_t)(normalizedDepth * ((1 << DEPTH_BITS) - 1));
+
+        return field(pass, PASS_BITS, PASS_SHIFT) |
+               field(programIndex, PROGRAM_BITS, PROGRAM_SHIFT) |
+               field(textureSet, TEXTURE_SET_BITS, TEXTURE_SET_SHIFT) |
+               field(packet.materialId, MATERIAL_BITS, MATERIAL_SHIFT) |
+               field(depth, DEPTH_BITS, DEPTH_SHIFT);
+    }
+
+    void RenderQueue::push(RenderPass pass, GLuint programIndex, const DrawPacket& packet, NodeId node, float depth, GLuint condition) {
+        RenderItem item;
+        item.packet = packet;
+        item.programIndex = programIndex;
+        item.node = node;
+        item.condition = condition;
+
+        SortEntry entry;
+        entry.key = makeKey(pass, programIndex, packet, pass == PASS_OPAQUE ? depth / maxDepth : 0.0f);
+        entry.item = (uint32_t)items.size();
+
+        pushedItems.push_back(entry.item);
+        items.push_back(item);
+        itemData.push_back(DrawData());
+        entries.push_back(entry);
+    }
+
+    // recorded draws already have their data, pushed ones get it here
+    void RenderQueue::packPushedItems(const SceneGraph& sceneGraph, const glm::mat3& viewRotation) {
+        for (size_t i = 0; i < pushedItems.size(); i++) {
+            uint32_t item = pushedItems[i];
+            packDrawData(itemData[item], sceneGraph, items[item].node, viewRotation, items[item].packet.materialId);
+        }
+    }
+
+    // LSD radix sort, one byte per pass; bytes that are the same for every key are skipped
+    void RenderQueue::sortEntries() {
+        size_t count = entries.size();
+        if (count < 2)
+            return;
+
+        scratch.resize(count);
+        SortEntry* src = &entries[0];
+        SortEntry* dst = &scratch[0];
+
+        for (int shift = 0; shift < 64; shift += 8) {
+            size_t offsets[256] = { 0 };
+            for (size_t i = 0; i < count; i++)
+                offsets[(src[i].key >> shift) & 0xFF]++;
+
+            if (offsets[(src[0].key >> shift) & 0xFF] == count)
+                continue;
+
+            size_t total = 0;
+            for (int b = 0; b < 256; b++) {
+                size_t bucketSize = offsets[b];
+                offsets[b] = total;
+                total += bucketSize;
+            }
+
+            for (size_t i = 0; i < count; i++)
+                dst[offsets[(src[i].key >> shift) & 0xFF]++] = src[i];
+
+            SortEntry* tmp = src;
+            src = dst;
+            dst = tmp;
+        }
+
+        if (src != &entries[0])
+            entries.swap(scratch);
+    }
+
+    // two sorted draws go in the same multi-draw if nothing but their per draw data differs
+    bool RenderQueue::canMerge(const SortEntry& first, const SortEntry& next) const {
+        const RenderItem& a = items[first.item];
+        const RenderItem& b = items[next.item];
+        if ((first.key >> PASS_SHIFT) != (next.key >> PASS_SHIFT) || a.programIndex != b.programIndex ||
+            a.packet.VAO != b.packet.VAO || a.condition != 0 || b.condition != 0)
+            return false;
+        for (int slot = 0; slot < TEXTURE_SLOT_COUNT; slot++) {
+            if (a.packet.textures[slot] != b.packet.textures[slot])
+                return false;
+        }
+        return true;
+    }
+
+    void RenderQueue::buildBatches() {
+        batches.clear();
+        commands.clear();
+        drawData.clear();
+
+        for (size_t i = 0; i < entries.size(); i++) {
+            const RenderItem& item = items[entries[i].item];
+
+            if (!programs[item.programIndex].indirect) {
+                Batch batch = { (uint32_t)i, 0, 1, false, 0 };
+                batches.push_back(batch);
+                continue;
+            }
+
+            // the arena only has draw indices for MAX_DRAWS draws, a full chunk starts a new batch
+            uint32_t chunk = (uint32_t)(drawData.size() / GeometryArena::MAX_DRAWS);
+            if (batches.empty() || !batches.back().indirect || batches.back().chunk != chunk ||
+                !canMerge(entries[batches.back().firstEntry], entries[i])) {
+                Batch batch = { (uint32_t)i, (uint32_t)commands.size(), 0, true, chunk };
+                batches.push_back(batch);
+            }
+
+            DrawElementsIndirectCommand command;
+            command.count = item.packet.indexCount;
+            command.instanceCount = 1;
+            command.firstIndex = item.packet.indexOffset / sizeof(GLuint);
+            command.baseVertex = item.packet.baseVertex;
+            command.baseInstance = (GLuint)(drawData.size() % GeometryArena::MAX_DRAWS);
+            commands.push_back(command);
+            drawData.push_back(itemData[entries[i].item]);
+
+            batches.back().drawCount++;
+        }
+    }
+
+    // all the commands and per draw data of the frame go up in one upload each
+    void RenderQueue::uploadIndirect() {
+        if (commands.empty())
+            return;
+
+        bool created = !commandBuffer;
+        if (created) {
+            commandBuffer = GLBuffer::create();
+            drawDataBuffer = GLBuffer::create();
+        }
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer.get());
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), &commands[0], GL_STREAM_DRAW);
+        countBufferUpload(commands.size() * sizeof(DrawElementsIndirectCommand));
+        trackBufferMemory(commandBuffer.get(), commands.size() * sizeof(DrawElementsIndirectCommand), GPU_MEMORY_STREAMING, "render queue");
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawDataBuffer.get());
+        glBufferData(GL_SHADER_STORAGE_BUFFER, drawData.size() * sizeof(DrawData), &drawData[0], GL_STREAM_DRAW);
+        countBufferUpload(drawData.size() * sizeof(DrawData));
+        trackBufferMemory(drawDataBuffer.get(), drawData.size() * sizeof(DrawData), GPU_MEMORY_STREAMING, "render queue");
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        // names only become objects once bound
+        if (created) {
+            setObjectLabel(GL_BUFFER, commandBuffer.get(), "queue commands");
+            setObjectLabel(GL_BUFFER, drawDataBuffer.get(), "queue draw data");
+        }
+    }
+
+    void RenderQueue::submit(const SceneGraph& sceneGraph, const glm::mat4& view) {
+        packPushedItems(sceneGraph, glm::mat3(view));
+        sortEntries();
+        memset(&stats, 0, sizeof(stats));
+
+        buildBatches();
+        uploadIndirect();
+
+        const GLuint none = GL_INVALID_INDEX;
+        int currentPass = -1;
+        GLuint currentProgram = none;
+        GLuint currentVAO = none;
+        GLuint currentMaterial = none;
+        uint32_t currentChunk = none;
+        NodeId currentNode = NO_PARENT;
+        GLuint boundTextures[TEXTURE_SLOT_COUNT];
+
+        for (size_t b = 0; b < batches.size(); b++) {
+            const Batch& batch = batches[b];
+            const RenderItem& item = items[entries[batch.firstEntry].item];
+            const DrawData& data = itemData[entries[batch.firstEntry].item];
+            const DrawPacket& packet = item.packet;
+            int pass = (int)(entries[batch.firstEntry].key >> PASS_SHIFT);
+
+            if (pass != currentPass) {
+                if (profiler) {
+                    if (currentPass != -1)
+                        profiler->endScope();
+                    profiler->beginScope(passNames[pass]);
+                }
+                glDepthFunc(passStates[pass].depthFunc);
+                // bindings of the previous pass were for another texture target
+                for (int slot = 0; slot < TEXTURE_SLOT_COUNT; slot++)
+                    boundTextures[slot] = none;
+                currentPass = pass;
+            }
+
+            const RenderProgram& program = programs[item.programIndex];
+            if (item.programIndex != currentProgram) {
+                glUseProgram(program.program);
+                currentProgram = item.programIndex;
+                currentNode = NO_PARENT;
+                stats.programSwitches++;
+                countProgramBind();
+            }
+
+            // indirect draws take the transform and material from their DrawData
+            if (!batch.indirect) {
+                if (item.node != NO_PARENT && item.node != currentNode) {
+                    glUniformMatrix4fv(program.modelLoc, 1, GL_FALSE, glm::value_ptr(data.model));
+                    glm::mat3 normalMatrix = glm::mat3(data.normalMatrix);
+                    glUniformMatrix3fv(program.normalMatrixLoc, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+                    currentNode = item.node;
+                    stats.transformUploads++;
+                    countUniformBytes(sizeof(glm::mat4) + sizeof(glm::mat3));
+                }
+
+                if (packet.materialId != currentMaterial) {
+                    glVertexAttribI1ui(MATERIAL_ID_ATTRIBUTE, packet.materialId);
+                    currentMaterial = packet.materialId;
+                    stats.materialChanges++;
+                }
+            }
+
+            for (GLuint slot = 0; slot < TEXTURE_SLOT_COUNT; slot++) {
+                if (packet.textures[slot] != boundTextures[slot]) {
+                    glActiveTexture(GL_TEXTURE0 + slot);
+                    glBindTexture(passStates[pass].textureTarget, packet.textures[slot]);
+                    boundTextures[slot] = packet.textures[slot];
+                    stats.textureBinds++;
+                    countTextureBinds();
+                }
+            }
+
+            if (packet.VAO != currentVAO) {
+                glBindVertexArray(packet.VAO);
+                currentVAO = packet.VAO;
+                stats.vaoBinds++;
+                countVaoBind();
+            }
+
+            // GL_QUERY_NO_WAIT draws anyway if the result is not ready, so the GPU never waits on it
+            if (item.condition != 0) {
+                glBeginConditionalRender(item.condition, GL_QUERY_NO_WAIT);
+                stats.conditionalDraws++;
+            }
+
+            if (batch.indirect) {
+                // chunk sizes are multiples of any storage buffer offset alignment
+                if (batch.chunk != currentChunk) {
+                    size_t first = (size_t)batch.chunk * GeometryArena::MAX_DRAWS;
+                    size_t count = drawData.size() - first < GeometryArena::MAX_DRAWS ? drawData.size() - first : GeometryArena::MAX_DRAWS;
+                    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, drawDataBuffer.get(),
+                        (GLintptr)(first * sizeof(DrawData)), (GLsizeiptr)(count * sizeof(DrawData)));
+                    currentChunk = batch.chunk;
+                }
+                glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                    (GLvoid*)(uintptr_t)(batch.firstCommand * sizeof(DrawElementsIndirectCommand)), batch.drawCount, 0);
+                // the commands were built here, so their counts are known
+                GLsizei vertices = 0;
+                for (GLsizei c = 0; c < batch.drawCount; c++)
+                    vertices += (GLsizei)commands[batch.firstCommand + c].count;
+                countDraw(GL_TRIANGLES, vertices);
+            }
+            else if (packet.indexType == GL_NONE) {
+                glDrawArrays(GL_TRIANGLES, 0, packet.indexCount);
+                countDraw(GL_TRIANGLES, packet.indexCount);
+            }
+            else {
+                glDrawElementsBaseVertex(GL_TRIANGLES, packet.indexCount, packet.indexType, (GLvoid*)(uintptr_t)packet.indexOffset, packet.baseVertex);
+                countDraw(GL_TRIANGLES, packet.indexCount);
+            }
+            stats.draws += batch.drawCount;
+            stats.drawCalls++;
+
+            if (item.condition != 0)
+                glEndConditionalRender();
+        }
+        if (profiler && currentPass != -1)
+            profiler->endScope();
+
+        glBindVertexArray(0);
+        glDepthFunc(GL_LESS);
+        if (!commands.empty())
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    size_t RenderQueue::size() const {
+        return items.size();
+    }
+
+    const RenderQueueStats& RenderQueue::getStats() const {
+        return stats;
+    }
+}
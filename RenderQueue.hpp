@@ -0,0 +1,212 @@
+#ifndef RenderQueue_hpp
+#define RenderQueue_hpp
+
+#include <GL/glew.h>
+#include "glm/glm.hpp"
+
+#include "Mesh.hpp"
+#include "Shader.hpp"
+#include "SceneGraph.hpp"
+#include "GeometryArena.hpp"
+#include "GLResource.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace gps {
+
+    class GpuProfiler;
+
+    // Passes are submitted in this order
+    enum RenderPass {
+        PASS_OPAQUE = 0,
+        // cube map on unit 0, depth func GL_LEQUAL
+        PASS_SKY,
+        PASS_COUNT
+    };
+
+    // Uniform locations the queue fills per draw, -1 if the program does not use them
+    struct RenderProgram {
+        GLuint program;
+        GLint modelLoc;
+        GLint normalMatrixLoc;
+        // reads its per draw data from the DrawData buffer instead of uniforms
+        bool indirect;
+    };
+
+    // Per draw data of indirect programs (std430), indexed by the base instance of the draw
+    struct DrawData {
+        glm::mat4 model;
+        // eye space normal matrix in the upper 3x3
+        glm::mat4 normalMatrix;
+        GLuint materialId;
+        GLuint padding[3];
+    };
+
+    // Layout glMultiDrawElementsIndirect reads its commands in
+    struct DrawElementsIndirectCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    // One queued draw
+    struct RenderItem {
+        DrawPacket packet;
+        GLuint programIndex;
+        // node whose transform is uploaded before the draw, NO_PARENT for none
+        NodeId node;
+        // occlusion query that gates the draw through conditional rendering, 0 for none
+        GLuint condition;
+    };
+
+    // What the last submit() did
+    struct RenderQueueStats {
+        unsigned int draws;
+        unsigned int programSwitches;
+        unsigned int textureBinds;
+        unsigned int vaoBinds;
+        unsigned int materialChanges;
+        unsigned int transformUploads;
+        unsigned int conditionalDraws;
+        // API draw calls, a multi-draw counts once
+        unsigned int drawCalls;
+    };
+
+    // Draws recorded off the GL thread, appended to a RenderQueue later
+    //
+    // Recording does everything that does not need the context: the sort key and the model and
+    // eye space normal matrices, packed the way the draw uploads them. Each list is filled by
+    // one job at a time and the lists are appended in order, so the frame does not depend on timing.
+    // A list holds no reference to the scene once recorded, it can outlive the frame it came from.
+    class RenderCommandList
+    {
+    public:
+        RenderCommandList();
+
+        // Empties the list and records against sceneGraph as seen through view from now on
+        // maxDepth is the depth range of the queue the list goes to
+        void begin(const SceneGraph& sceneGraph, const glm::mat4& view, float maxDepth);
+        void clear();
+
+        // Same as RenderQueue::push; the transform of node is read from the scene graph right away
+        void push(RenderPass pass, GLuint programIndex, const DrawPacket& packet, NodeId node, float depth, GLuint condition = 0);
+
+        size_t size() const;
+
+    private:
+        friend class RenderQueue;
+
+        const SceneGraph* sceneGraph;
+        glm::mat3 viewRotation;
+        float maxDepth;
+
+        std::vector<RenderItem> items;
+        std::vector<uint64_t> keys;
+        std::vector<DrawData> drawData;
+    };
+
+    // Collects the draws of a frame, sorts them by a 64 bit key and submits them
+    // with as few state changes as possible
+    //
+    // Key layout, most significant bits first:
+    //   pass (4) | program (6) | texture set (20) | material (10) | depth (24)
+    // so passes run in order, draws are grouped by state and opaque draws of the same
+    // state go front to back for early-Z
+    //
+    // Draws of indirect programs that share pass, program, textures and VAO are merged into
+    // one glMultiDrawElementsIndirect; their transforms and materials go to a shader storage
+    // buffer and the draw finds its entry through its base instance (GeometryArena::DRAW_INDEX_ATTRIBUTE).
+    // Base instances only go up to GeometryArena::MAX_DRAWS, so a frame with more indirect draws
+    // is split in chunks of that many, each drawn with its own range of the buffer bound.
+    // Materials live in a uniform buffer, so only textures split the buckets.
+    //
+    // Draws come from push() on the GL thread or from RenderCommandLists recorded on workers.
+    class RenderQueue
+    {
+    public:
+        static const GLuint MAX_PROGRAMS = 64;
+        // shader storage binding of the DrawData buffer
+        static const GLuint DRAW_DATA_BINDING = 1;
+
+        RenderQueue();
+        RenderQueue(RenderQueue&&) = default;
+        RenderQueue& operator=(RenderQueue&&) = default;
+        RenderQueue(const RenderQueue&) = delete;
+        RenderQueue& operator=(const RenderQueue&) = delete;
+
+        // Registers a program and points its texture samplers at their units
+        // Draws of an indirect program must use 32 bit indices from a GeometryArena (GL 4.3)
+        // Returns the index to queue draws with
+        GLuint addProgram(const Shader& shader, bool indirect = false);
+
+        // View space depths are quantized over [0, maxDepth], usually the far plane
+        void setDepthRange(float maxDepth);
+        float getDepthRange() const;
+
+        // Times every pass of submit() as a scope of profiler, NULL to stop
+        void setProfiler(GpuProfiler* profiler);
+
+        void clear();
+
+        // Queues the draws of a recorded list
+        void append(const RenderCommandList& list);
+
+        // depth is the view space distance of the draw, ignored outside PASS_OPAQUE
+        // condition is an occlusion query, the draw is skipped by the GPU if it passed no samples
+        void push(RenderPass pass, GLuint programIndex, const DrawPacket& packet, NodeId node, float depth, GLuint condition = 0);
+
+        // Sorts the queued draws by key and issues them
+        // The model matrix of a draw comes from the scene graph, its normal matrix is moved to eye space with view
+        void submit(const SceneGraph& sceneGraph, const glm::mat4& view);
+
+        size_t size() const;
+        const RenderQueueStats& getStats() const;
+
+        static uint64_t makeKey(RenderPass pass, GLuint programIndex, const DrawPacket& packet, float normalizedDepth);
+
+    private:
+        struct SortEntry {
+            uint64_t key;
+            uint32_t item;
+        };
+
+        // consecutive sorted entries issued with one call
+        struct Batch {
+            uint32_t firstEntry;
+            uint32_t firstCommand;
+            GLsizei drawCount;
+            bool indirect;
+            // MAX_DRAWS entries of the draw data the base instances of the batch point into
+            uint32_t chunk;
+        };
+
+        std::vector<RenderProgram> programs;
+        std::vector<RenderItem> items;
+        // transform and material of every item, as DrawData or per draw uniforms upload them
+        std::vector<DrawData> itemData;
+        // pushed items, their data is packed in submit() when the scene graph is known
+        std::vector<uint32_t> pushedItems;
+        std::vector<SortEntry> entries;
+        std::vector<SortEntry> scratch;
+        float maxDepth;
+        RenderQueueStats stats;
+        GpuProfiler* profiler;
+
+        std::vector<Batch> batches;
+        std::vector<DrawElementsIndirectCommand> commands;
+        std::vector<DrawData> drawData;
+        GLBuffer commandBuffer;
+        GLBuffer drawDataBuffer;
+
+        void packPushedItems(const SceneGraph& sceneGraph, const glm::mat3& viewRotation);
+        void sortEntries();
+        bool canMerge(const SortEntry& first, const SortEntry& next) const;
+        void buildBatches();
+        void uploadIndirect();
+    };
+}
+
+#endif /* RenderQueue_hpp */
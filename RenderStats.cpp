@@ -0,0 +1,76 @@
+#include "RenderStats.hpp"
+
+namespace gps {
+
+    static RenderStats current = RenderStats();
+    static RenderStats last = RenderStats();
+    static RenderStats total = RenderStats();
+
+    static void addTo(RenderStats& sum, const RenderStats& stats) {
+        sum.drawCalls += stats.drawCalls;
+        sum.triangles += stats.triangles;
+        sum.vertices += stats.vertices;
+        sum.programBinds += stats.programBinds;
+        sum.vaoBinds += stats.vaoBinds;
+        sum.textureBinds += stats.textureBinds;
+        sum.uniformBytes += stats.uniformBytes;
+        sum.bufferBytes += stats.bufferBytes;
+        sum.textureBytes += stats.textureBytes;
+    }
+
+    void beginRenderStatsFrame() {
+        addTo(total, current);
+        current = RenderStats();
+    }
+
+    void endRenderStatsFrame() {
+        addTo(total, current);
+        last = current;
+        current = RenderStats();
+    }
+
+    const RenderStats& getRenderStats() {
+        return last;
+    }
+
+    const RenderStats& getTotalRenderStats() {
+        return total;
+    }
+
+    void countDraw(GLenum mode, GLsizei vertices, GLsizei instances) {
+        current.drawCalls++;
+        current.vertices += (unsigned long long)vertices * instances;
+        if (mode == GL_TRIANGLES)
+            current.triangles += (unsigned long long)(vertices / 3) * instances;
+        else if (mode == GL_TRIANGLE_STRIP || mode == GL_TRIANGLE_FAN)
+            current.triangles += (unsigned long long)(vertices > 2 ? vertices - 2 : 0) * instances;
+    }
+
+    void countIndirectDraw() {
+        current.drawCalls++;
+    }
+
+    void countProgramBind() {
+        current.programBinds++;
+    }
+
+    void countVaoBind() {
+        current.vaoBinds++;
+    }
+
+    void countTextureBinds(unsigned int binds) {
+        current.textureBinds += binds;
+    }
+
+    void countUniformBytes(size_t bytes) {
+        current.uniformBytes += bytes;
+    }
+
+    void countBufferUpload(size_t bytes) {
+        current.bufferBytes += bytes;
+    }
+
+    void countTextureUpload(size_t bytes) {
+        current.textureBytes += bytes;
+    }
+}
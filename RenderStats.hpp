@@ -0,0 +1,50 @@
+#ifndef RenderStats_hpp
+#define RenderStats_hpp
+
+#include <GL/glew.h>
+
+#include <cstddef>
+
+namespace gps {
+
+    // What the GL thread asked of the driver, per frame
+    struct RenderStats {
+        // API draw calls, a multi-draw counts once
+        unsigned int drawCalls;
+        // submitted by the CPU, the draws of GPU built indirect commands are not known here
+        unsigned long long triangles;
+        unsigned long long vertices;
+        unsigned int programBinds;
+        unsigned int vaoBinds;
+        unsigned int textureBinds;
+        unsigned long long uniformBytes;
+        unsigned long long bufferBytes;
+        unsigned long long textureBytes;
+    };
+
+    // Render statistics
+    //
+    // The draw, bind and upload sites count what they do here, so the effect of an optimization
+    // shows up as numbers. The counters are plain globals written from the GL thread only.
+    // Work between endRenderStatsFrame() and the next beginRenderStatsFrame(), like loading,
+    // is not part of any frame but still goes into the totals.
+
+    void beginRenderStatsFrame();
+    void endRenderStatsFrame();
+    // the last frame ended and everything counted since the start
+    const RenderStats& getRenderStats();
+    const RenderStats& getTotalRenderStats();
+
+    // vertices in one draw of mode, instances times
+    void countDraw(GLenum mode, GLsizei vertices, GLsizei instances = 1);
+    // a draw whose counts the GPU decides
+    void countIndirectDraw();
+    void countProgramBind();
+    void countVaoBind();
+    void countTextureBinds(unsigned int binds = 1);
+    void countUniformBytes(size_t bytes);
+    void countBufferUpload(size_t bytes);
+    void countTextureUpload(size_t bytes);
+}
+
+#endif /* RenderStats_hpp */
@@ -0,0 +1,111 @@
+#include "SceneGraph.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+#include <glm/gtx/quaternion.hpp>
+
+namespace gps {
+
+    NodeId SceneGraph::addNode(NodeId parent) {
+        parents.push_back(parent);
+        translations.push_back(glm::vec3(0.0f));
+        rotations.push_back(glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+        scales.push_back(glm::vec3(1.0f));
+        dirty.push_back(1);
+        changed.push_back(0);
+        worldMatrices.push_back(glm::mat4(1.0f));
+        normalMatrices.push_back(glm::mat3(1.0f));
+
+        return (NodeId)parents.size() - 1;
+    }
+
+    void SceneGraph::setTranslation(NodeId node, const glm::vec3& translation) {
+        if (translations[node] != translation) {
+            translations[node] = translation;
+            dirty[node] = 1;
+        }
+    }
+
+    void SceneGraph::setRotation(NodeId node, const glm::quat& rotation) {
+        const glm::quat& current = rotations[node];
+        if (current.x != rotation.x || current.y != rotation.y || current.z != rotation.z || current.w != rotation.w) {
+            rotations[node] = rotation;
+            dirty[node] = 1;
+        }
+    }
+
+    void SceneGraph::setScale(NodeId node, const glm::vec3& scale) {
+        if (scales[node] != scale) {
+            scales[node] = scale;
+            dirty[node] = 1;
+        }
+    }
+
+    NodeId SceneGraph::getParent(NodeId node) const {
+        return parents[node];
+    }
+
+    const glm::vec3& SceneGraph::getTranslation(NodeId node) const {
+        return translations[node];
+    }
+
+    const glm::quat& SceneGraph::getRotation(NodeId node) const {
+        return rotations[node];
+    }
+
+    const glm::vec3& SceneGraph::getScale(NodeId node) const {
+        return scales[node];
+    }
+
+    size_t SceneGraph::update() {
+        size_t updated = 0;
+
+        for (size_t i = 0; i < parents.size(); i++) {
+            NodeId parent = parents[i];
+            // parents come first, so their changed flag is already final
+            bool parentChanged = parent != NO_PARENT && changed[parent];
+
+            if (!dirty[i] && !parentChanged) {
+                changed[i] = 0;
+                continue;
+            }
+
+            glm::mat4 local = glm::translate(glm::mat4(1.0f), translations[i]);
+            local = local * glm::toMat4(rotations[i]);
+            local = glm::scale(local, scales[i]);
+
+            worldMatrices[i] = parent == NO_PARENT ? local : worldMatrices[parent] * local;
+            normalMatrices[i] = glm::inverseTranspose(glm::mat3(worldMatrices[i]));
+
+            dirty[i] = 0;
+            changed[i] = 1;
+            updated++;
+        }
+
+        return updated;
+    }
+
+    const glm::mat4& SceneGraph::getWorldMatrix(NodeId node) const {
+        return worldMatrices[node];
+    }
+
+    const glm::mat3& SceneGraph::getNormalMatrix(NodeId node) const {
+        return normalMatrices[node];
+    }
+
+    bool SceneGraph::worldChanged(NodeId node) const {
+        return changed[node] != 0;
+    }
+
+    const glm::mat4* SceneGraph::getWorldMatrices() const {
+        return worldMatrices.data();
+    }
+
+    const glm::mat3* SceneGraph::getNormalMatrices() const {
+        return normalMatrices.data();
+    }
+
+    size_t SceneGraph::size() const {
+        return parents.size();
+    }
+}
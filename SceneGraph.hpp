@@ -0,0 +1,61 @@
+#ifndef SceneGraph_hpp
+#define SceneGraph_hpp
+
+#include "glm/glm.hpp"
+#include <glm/gtc/quaternion.hpp>
+
+#include <vector>
+
+namespace gps {
+
+    typedef int NodeId;
+    const NodeId NO_PARENT = -1;
+
+    // Hierarchy of nodes with a local translation/rotation/scale and cached world transforms
+    // All the node data is kept in parallel arrays indexed by NodeId. A node is always added
+    // after its parent, so update() is a single forward pass over the arrays.
+    class SceneGraph
+    {
+    public:
+        NodeId addNode(NodeId parent = NO_PARENT);
+
+        // Setters only mark the node dirty if the value actually changes
+        void setTranslation(NodeId node, const glm::vec3& translation);
+        void setRotation(NodeId node, const glm::quat& rotation);
+        void setScale(NodeId node, const glm::vec3& scale);
+
+        NodeId getParent(NodeId node) const;
+        const glm::vec3& getTranslation(NodeId node) const;
+        const glm::quat& getRotation(NodeId node) const;
+        const glm::vec3& getScale(NodeId node) const;
+
+        // Recomputes the world and normal matrices of the dirty nodes and everything below them
+        // Returns the number of nodes that were recomputed
+        size_t update();
+
+        const glm::mat4& getWorldMatrix(NodeId node) const;
+        const glm::mat3& getNormalMatrix(NodeId node) const;
+        // True if the world matrix of the node changed in the last update()
+        bool worldChanged(NodeId node) const;
+
+        // Contiguous world matrices of all the nodes, in NodeId order
+        const glm::mat4* getWorldMatrices() const;
+        const glm::mat3* getNormalMatrices() const;
+        size_t size() const;
+
+    private:
+        std::vector<NodeId> parents;
+        std::vector<glm::vec3> translations;
+        std::vector<glm::quat> rotations;
+        std::vector<glm::vec3> scales;
+        // local transform changed since the last update
+        std::vector<unsigned char> dirty;
+        // world transform changed during the last update
+        std::vector<unsigned char> changed;
+
+        std::vector<glm::mat4> worldMatrices;
+        std::vector<glm::mat3> normalMatrices;
+    };
+}
+
+#endif /* SceneGraph_hpp */
@@ -1,4 +1,5 @@
 #include "Shader.hpp"
+#include "GLDebug.hpp"
 
 namespace gps {
     std::string Shader::readShaderFile(std::string fileName)
@@ -44,7 +45,7 @@ namespace gps {
         //check linking info
         glGetProgramiv(shaderProgramId, GL_LINK_STATUS, &success);
         if(!success) {
-            glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
+            glGetProgramInfoLog(shaderProgramId, 512, NULL, infoLog);
             std::cout << "Shader linking error\n" << infoLog << std::endl;
         }
     }
@@ -72,19 +73,37 @@ namespace gps {
         shaderCompileLog(fragmentShader);
 
         //attach and link the shader programs
-        this->shaderProgram = glCreateProgram();
-        glAttachShader(this->shaderProgram, vertexShader);
-        glAttachShader(this->shaderProgram, fragmentShader);
-        glLinkProgram(this->shaderProgram);
+        this->shaderProgram.reset(glCreateProgram());
+        glAttachShader(this->shaderProgram.get(), vertexShader);
+        glAttachShader(this->shaderProgram.get(), fragmentShader);
+        glLinkProgram(this->shaderProgram.get());
         glDeleteShader(vertexShader);
         glDeleteShader(fragmentShader);
         //check linking info
-        shaderLinkLog(this->shaderProgram);
+        shaderLinkLog(this->shaderProgram.get());
+        setObjectLabel(GL_PROGRAM, this->shaderProgram.get(), vertexShaderFileName + " + " + fragmentShaderFileName);
     }
 
-    void Shader::useShaderProgram()
+    void Shader::loadComputeShader(std::string computeShaderFileName)
     {
-        glUseProgram(this->shaderProgram);
+        std::string c = readShaderFile(computeShaderFileName);
+        const GLchar* computeShaderString = c.c_str();
+        GLuint computeShader = glCreateShader(GL_COMPUTE_SHADER);
+        glShaderSource(computeShader, 1, &computeShaderString, NULL);
+        glCompileShader(computeShader);
+        shaderCompileLog(computeShader);
+
+        this->shaderProgram.reset(glCreateProgram());
+        glAttachShader(this->shaderProgram.get(), computeShader);
+        glLinkProgram(this->shaderProgram.get());
+        glDeleteShader(computeShader);
+        shaderLinkLog(this->shaderProgram.get());
+        setObjectLabel(GL_PROGRAM, this->shaderProgram.get(), computeShaderFileName);
+    }
+
+    void Shader::useShaderProgram() const
+    {
+        glUseProgram(this->shaderProgram.get());
     }
 
 }
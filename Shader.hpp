@@ -3,6 +3,8 @@
 
 #include <GL/glew.h>
 
+#include "GLResource.hpp"
+
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -11,12 +13,22 @@
 
 namespace gps {
 
+// Owns a linked program; move-only, pass it around by reference
 class Shader
 {
 public:
-    GLuint shaderProgram;
+    GLProgram shaderProgram;
+
+    Shader() {}
+    Shader(Shader&&) = default;
+    Shader& operator=(Shader&&) = default;
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
+
     void loadShader(std::string vertexShaderFileName, std::string fragmentShaderFileName);
-    void useShaderProgram();
+    // Compute program, needs GL 4.3
+    void loadComputeShader(std::string computeShaderFileName);
+    void useShaderProgram() const;
 
 private:
     std::string readShaderFile(std::string fileName);
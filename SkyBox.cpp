@@ -7,6 +7,9 @@
 //
 
 #include "SkyBox.hpp"
+#include "GLDebug.hpp"
+#include "RenderStats.hpp"
+#include "AllocationTracker.hpp"
 
 namespace gps {
     
@@ -15,42 +18,71 @@ namespace gps {
         
     }
     
-    void SkyBox::Load(std::vector<const GLchar*> cubeMapFaces)
+    void SkyBox::Load(const std::vector<const GLchar*>& cubeMapFaces)
     {
-        cubemapTexture = LoadSkyBoxTextures(cubeMapFaces);
+        GpuMemoryScope memoryScope(cubeMapFaces.empty() ? "skybox" : cubeMapFaces[0]);
+        cubemapTexture.reset(LoadSkyBoxTextures(cubeMapFaces));
+        setObjectLabel(GL_TEXTURE, cubemapTexture.get(), "skybox");
         InitSkyBox();
     }
     
-    void SkyBox::Draw(gps::Shader shader, glm::mat4 viewMatrix, glm::mat4 projectionMatrix)
+    void SkyBox::Draw(const gps::Shader& shader, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix)
     {
-        shader.useShaderProgram();
-        
-        //set the view and projection matrices
-        glm::mat4 transformedView = glm::mat4(glm::mat3(viewMatrix));
-        glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(transformedView));
-        glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projectionMatrix));
+        UpdateUniforms(shader, viewMatrix, projectionMatrix);
         
         glDepthFunc(GL_LEQUAL);
         
-        glBindVertexArray(skyboxVAO);
+        glBindVertexArray(skyboxVAO.get());
         glActiveTexture(GL_TEXTURE0);
-        glUniform1i(glGetUniformLocation(shader.shaderProgram, "skybox"), 0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture.get());
         glDrawArrays(GL_TRIANGLES, 0, 36);
         glBindVertexArray(0);
+        countVaoBind();
+        countTextureBinds();
+        countDraw(GL_TRIANGLES, 36);
         
         glDepthFunc(GL_LESS);
     }
     
-    GLuint SkyBox::LoadSkyBoxTextures(std::vector<const GLchar*> skyBoxFaces)
+    void SkyBox::UpdateUniforms(const gps::Shader& shader, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix)
+    {
+        shader.useShaderProgram();
+        
+        //set the view and projection matrices
+        glm::mat4 transformedView = glm::mat4(glm::mat3(viewMatrix));
+        glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram.get(), "view"), 1, GL_FALSE, glm::value_ptr(transformedView));
+        glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram.get(), "projection"), 1, GL_FALSE, glm::value_ptr(projectionMatrix));
+        glUniform1i(glGetUniformLocation(shader.shaderProgram.get(), "skybox"), 0);
+        countProgramBind();
+        countUniformBytes(2 * sizeof(glm::mat4) + sizeof(GLint));
+    }
+    
+    DrawPacket SkyBox::GetDrawPacket() const
+    {
+        DrawPacket packet;
+        packet.VAO = skyboxVAO.get();
+        packet.indexOffset = 0;
+        packet.baseVertex = 0;
+        packet.indexCount = 36;
+        packet.indexType = GL_NONE;
+        packet.materialId = 0;
+        packet.textures[0] = cubemapTexture.get();
+        for (int slot = 1; slot < TEXTURE_SLOT_COUNT; slot++)
+            packet.textures[slot] = 0;
+        return packet;
+    }
+    
+    GLuint SkyBox::LoadSkyBoxTextures(const std::vector<const GLchar*>& skyBoxFaces)
     {
-        GLuint textureID;
-        glGenTextures(1, &textureID);
+        AllocationScope allocationScope(ALLOCATION_TEXTURES);
+        GLTexture texture = GLTexture::create();
+        GLuint textureID = texture.get();
         glActiveTexture(GL_TEXTURE0);
         
         int width,height, n;
         unsigned char* image;
         int force_channels = 3;
+        size_t bytes = 0;
         
         glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
         for(GLuint i = 0; i < skyBoxFaces.size(); i++)
@@ -64,7 +96,11 @@ namespace gps {
                          GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0,
                          GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image
                          );
+            countTextureUpload((size_t)width * height * force_channels);
+            bytes += textureStorageBytes(GL_RGB8, width, height, 1, 1, 1);
+            stbi_image_free(image);
         }
+        trackTextureMemory(textureID, bytes, GPU_MEMORY_TEXTURES);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -72,7 +108,7 @@ namespace gps {
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
         glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
         
-        return textureID;
+        return texture.release();
     }
     
     void SkyBox::InitSkyBox()
@@ -121,21 +157,25 @@ namespace gps {
             1.0f, -1.0f,  1.0f
         };
         
-        glGenVertexArrays(1, &(this->skyboxVAO));
-        glGenBuffers(1, &skyboxVBO);
+        skyboxVAO = GLVertexArray::create();
+        skyboxVBO = GLBuffer::create();
         
-        glBindVertexArray(skyboxVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
+        glBindVertexArray(skyboxVAO.get());
+        glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO.get());
         glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
+        countBufferUpload(sizeof(skyboxVertices));
+        trackBufferMemory(skyboxVBO.get(), sizeof(skyboxVertices), GPU_MEMORY_GEOMETRY);
         
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
         
         glBindVertexArray(0);
+        setObjectLabel(GL_VERTEX_ARRAY, skyboxVAO.get(), "skybox VAO");
+        setObjectLabel(GL_BUFFER, skyboxVBO.get(), "skybox vertices");
     }
     
     GLuint SkyBox::GetTextureId()
     {
-        return cubemapTexture;
+        return cubemapTexture.get();
     }
 }
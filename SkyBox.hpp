@@ -11,6 +11,8 @@
 
 #include <stdio.h>
 #include "Shader.hpp"
+#include "Mesh.hpp"
+#include "GLResource.hpp"
 #include <vector>
 #include "stb_image.h"
 #include "glm/glm.hpp"
@@ -21,14 +23,22 @@ namespace gps {
     {
     public:
         SkyBox();
-        void Load(std::vector<const GLchar*> cubeMapFaces);
-        void Draw(gps::Shader shader, glm::mat4 viewMatrix, glm::mat4 projectionMatrix);
+        SkyBox(SkyBox&&) = default;
+        SkyBox& operator=(SkyBox&&) = default;
+        SkyBox(const SkyBox&) = delete;
+        SkyBox& operator=(const SkyBox&) = delete;
+        void Load(const std::vector<const GLchar*>& cubeMapFaces);
+        void Draw(const gps::Shader& shader, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix);
+        // Sets the camera uniforms of the skybox shader, Draw does it by itself
+        void UpdateUniforms(const gps::Shader& shader, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix);
+        // Non indexed packet with the cube map on unit 0, drawn with depth func GL_LEQUAL
+        DrawPacket GetDrawPacket() const;
         GLuint GetTextureId();
     private:
-        GLuint skyboxVAO;
-        GLuint skyboxVBO;
-        GLuint cubemapTexture;
-        GLuint LoadSkyBoxTextures(std::vector<const GLchar*> cubeMapFaces);
+        GLVertexArray skyboxVAO;
+        GLBuffer skyboxVBO;
+        GLTexture cubemapTexture;
+        GLuint LoadSkyBoxTextures(const std::vector<const GLchar*>& cubeMapFaces);
         void InitSkyBox();
     };
 }
@@ -2,9 +2,18 @@
 
 namespace gps {
 
-    void Window::Create(int width, int height, const char *title) {
+    void Window::Create(int width, int height, const char *title, bool headless) {
+        bool offscreen = false;
         if (!glfwInit()) {
-            throw std::runtime_error("Could not start GLFW3!");
+#ifdef GLFW_PLATFORM_NULL
+            // no display server, the null platform only has offscreen contexts
+            if (headless) {
+                glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+                offscreen = glfwInit() == GLFW_TRUE;
+            }
+#endif
+            if (!offscreen)
+                throw std::runtime_error("Could not start GLFW3!");
         }
 
         //window hints
@@ -19,6 +28,18 @@ namespace gps {
         // for multisampling/antialising
         glfwWindowHint(GLFW_SAMPLES, 4);
 
+#ifdef _DEBUG
+        // drivers only report everything through KHR_debug in a debug context
+        glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
+#endif
+
+        if (headless)
+            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef GLFW_OSMESA_CONTEXT_API
+        if (offscreen)
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+#endif
+
         this->window = glfwCreateWindow(width, height, title, NULL, NULL);
         if (!this->window) {
             throw std::runtime_error("Could not create GLFW3 window!");
@@ -16,7 +16,9 @@ namespace gps {
     class Window {
 
     public:
-        void Create(int width=800, int height=600, const char *title="OpenGL Project");
+        // headless: the window stays hidden, and without a display GLFW falls back to an OSMesa
+        // context when it was built with one, so the scene renders on Mesa's software rasterizer
+        void Create(int width=800, int height=600, const char *title="OpenGL Project", bool headless=false);
         void Delete();
 
         GLFWwindow* getWindow();
@@ -8,6 +8,7 @@
 #include <glm/gtc/type_ptr.hpp> //glm extension for accessing the internal data structure of glm types
 
 #include <cmath>
+#include <cstring>
 #include <GL/gl.h>
 #include <GL/GLU.h>;
 
@@ -16,6 +17,26 @@
 #include "Camera.hpp"
 #include "Model3D.hpp"
 #include "SkyBox.hpp"
+#include "MaterialTable.hpp"
+#include "SceneGraph.hpp"
+#include "RenderQueue.hpp"
+#include "GeometryArena.hpp"
+#include "FrustumCulling.hpp"
+#include "OcclusionCulling.hpp"
+#include "OcclusionQueries.hpp"
+#include "GpuCulling.hpp"
+#include "JobSystem.hpp"
+#include "FramePipeline.hpp"
+#include "Benchmarks.hpp"
+#include "CameraPath.hpp"
+#include "GpuProfiler.hpp"
+#include "CpuProfiler.hpp"
+#include "FlightRecorder.hpp"
+#include "GLDebug.hpp"
+#include "RenderStats.hpp"
+#include "GpuMemory.hpp"
+#include "AllocationTracker.hpp"
+#include "FrameArena.hpp"
 
 #include <glm/gtc/quaternion.hpp> 
 #include <glm/gtx/quaternion.hpp>
@@ -23,6 +44,8 @@
 #include <iostream>
 #include <chrono>
 #include <thread>
+#include <random>
+#include <mutex>
 #include <stdio.h>
 #include <Windows.h>
 #include <conio.h>
@@ -35,17 +58,15 @@
 gps::Window myWindow;
 
 // matrices
-glm::mat4 model;
 glm::mat4 view;
 glm::mat4 projection;
-glm::mat3 normalMatrix;
-glm::mat4 axeMatrix;
 
 glm::mat3 lightDirMatrix;
 GLuint lightDirMatrixLoc;
 
 // light parameters
 glm::vec3 lightDir;
+glm::vec3 lightDirEye;
 glm::vec3 lightColor;
 
 // shader uniform locations
@@ -54,6 +75,7 @@ GLint viewLoc;
 GLint projectionLoc;
 GLint normalMatrixLoc;
 GLint lightDirLoc;
+GLint lightDirEyeLoc;
 GLint lightColorLoc;
 
 // camera
@@ -74,6 +96,161 @@ gps::Model3D woodLog1;
 gps::Model3D woodLog2;
 GLfloat angle;
 
+// scene hierarchy, the axe and the logs hang off pivot nodes they rotate around
+gps::SceneGraph sceneGraph;
+gps::NodeId sceneRootNode;
+gps::NodeId teapotNode;
+gps::NodeId groundNode;
+gps::NodeId axePivotNode;
+gps::NodeId axeNode;
+gps::NodeId woodLog1PivotNode;
+gps::NodeId woodLog1Node;
+gps::NodeId woodLog2PivotNode;
+gps::NodeId woodLog2Node;
+
+// worker threads for the CPU side of a frame, the main thread helps while it waits
+gps::JobSystem jobSystem;
+
+// static geometry of all the models, in one vertex and one index buffer
+gps::GeometryArena geometryArena;
+// GL 4.3: the scene goes out in one multi-draw per texture set, with per draw data in a buffer
+bool indirectDrawing = false;
+
+// draws of the current frame
+gps::RenderQueue renderQueue;
+GLuint basicProgramIndex;
+GLuint skyBoxProgramIndex;
+
+// every mesh of the scene with the node it hangs from, its world bounds are at the same index in sceneBounds
+struct SceneEntry {
+	const gps::Model3D* model;
+	gps::NodeId node;
+	size_t mesh;
+};
+std::vector<SceneEntry> sceneEntries;
+gps::BoundsSoA sceneBounds;
+std::vector<uint32_t> visibleEntries;
+gps::CullStats cullStats;
+
+// the scene is culled and recorded in chunks of entries, one job and one command list each
+const size_t RECORD_CHUNK_SIZE = 256;
+struct RecordChunk {
+	std::vector<uint32_t> visible;
+	unsigned int inFrustum;
+	unsigned int occluded;
+};
+std::vector<RecordChunk> recordChunks;
+
+// hidden meshes are skipped either on the CPU, where the big meshes of the ground are the
+// occluders, or on the GPU with occlusion queries; O cycles through the modes
+enum OcclusionMode {
+	OCCLUSION_OFF,
+	OCCLUSION_CPU,
+	OCCLUSION_GPU_QUERIES,
+	OCCLUSION_MODE_COUNT
+};
+OcclusionMode occlusionMode = OCCLUSION_CPU;
+gps::OcclusionCuller occlusionCuller;
+gps::OcclusionQueries occlusionQueries;
+
+// input as the main thread last saw it, a frame is simulated with a copy taken when it starts
+struct InputSnapshot {
+	GLboolean keys[1024];
+	bool mouseMoved;
+	float pitch, yaw;
+	OcclusionMode occlusionMode;
+	glm::mat4 projection;
+	double time;
+};
+std::mutex inputMutex;
+InputSnapshot latestInput;
+
+// everything the render thread needs from the simulation of one frame
+struct FramePacket {
+	// counts from 1, picks the frame arena slot the simulation allocates from
+	unsigned int frame;
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec3 cameraPosition;
+	OcclusionMode occlusionMode;
+	// one list per chunk of the scene, recorded by the jobs
+	std::vector<gps::RenderCommandList> commandLists;
+	size_t commandListCount;
+	gps::CullStats cullStats;
+	double inputTime;
+	// when the simulation of the frame started, for the flight recorder
+	double simulateStart;
+	float simulateTime;
+};
+
+// --pipeline: frame N+1 is simulated on its own thread while the main thread renders frame N
+// GPU occlusion queries need the GL thread while recording, so the pipeline skips that mode
+bool pipelined = false;
+// --no-vsync and --fps-limit N: the simulation runs on a fixed step, so any frame rate shows the same motion
+bool vsync = true;
+int fpsLimit = 0;
+// --benchmark [frames]: a hidden window flies a scripted path with fixed simulation time, the frame
+// times, draw counts, load times and the fragment cost comparison go to the JSON file given with --benchmark-out
+// with --replay-camera it flies the recorded path instead, by default all of it
+int benchmarkFrames = 0;
+const char* benchmarkOutput = "benchmark.json";
+// time spent in each part of the startup, in ms
+struct LoadTimes {
+	double window;
+	double models;
+	double scene;
+	double shaders;
+	double total;
+};
+LoadTimes loadTimes;
+// --record-camera file: a keyframe every few steps from step 0 plus every change of the keys the steps saw, written at exit
+// --replay-camera file: the camera follows the spline through the keyframes and the keys replay,
+// both on simulation time, so a replay shows the same views on any machine and at any frame rate
+// the mouse only turns the camera, which the keyframes already hold, so it isn't recorded
+const int CAMERA_KEYFRAME_STEPS = 6;
+const char* cameraRecordFile = NULL;
+gps::CameraPath cameraRecording;
+// keys as the last recorded step saw them
+GLboolean cameraRecordKeys[1024];
+gps::CameraPath cameraReplay;
+bool replayingCamera = false;
+size_t cameraReplayEvent = 0;
+GLboolean cameraReplayKeys[1024];
+// GPU time per pass, P shows the overlay and the times in the title
+// --gpu-profile file.csv|file.json writes the history at exit
+gps::GpuProfiler gpuProfiler;
+bool profilerOverlay = false;
+const char* gpuProfileFile = NULL;
+// R shows the render statistics of the last frame in the title instead of the queue's
+bool renderStatsTitle = false;
+// heap allocations of all threads during the last frame, in builds that track them (see AllocationTracker.hpp)
+unsigned int frameAllocations = 0;
+// keeps the last frames and writes a trace around any frame over the budget
+// --hitch-budget ms (0 turns it off) and --hitch-prefix path
+gps::FlightRecorder flightRecorder;
+// --gl-debug notification|low|medium|high: least severe GL debug message printed
+#ifdef _DEBUG
+GLenum debugSeverity = GL_DEBUG_SEVERITY_MEDIUM;
+#else
+GLenum debugSeverity = GL_DEBUG_SEVERITY_HIGH;
+#endif
+// --trace file: CPU zones as a Chrome trace at exit, in builds that record them (see CpuProfiler.hpp)
+const char* traceFile = NULL;
+gps::FramePipeline framePipeline;
+FramePacket framePackets[gps::FramePipeline::PACKET_COUNT];
+// a frame's arena is reset when the frame FRAME_ARENA_SLOTS later starts, so every packet in flight keeps its own
+static_assert(gps::FramePipeline::PACKET_COUNT < gps::FRAME_ARENA_SLOTS, "frame arenas would be reset while a packet uses them");
+unsigned int simulatedFrames = 0;
+std::thread simulationThread;
+
+// --scatter N: N copies of a wood log around the scene, culled and drawn by the GPU
+int scatterCount = 0;
+gps::GpuCuller gpuCuller;
+gps::Shader instancedShader;
+
+// materials of all the models, in one uniform buffer
+gps::MaterialTable materialTable;
+
 // shaders
 gps::Shader myBasicShader;
 gps::Shader lightShader;
@@ -116,7 +293,12 @@ GLenum glCheckError_(const char *file, int line)
 	}
 	return errorCode;
 }
+// the debug output reports errors as they happen, the polling is only kept in checked builds
+#if GPS_GL_CHECKS
 #define glCheckError() glCheckError_(__FILE__, __LINE__)
+#else
+#define glCheckError() ((void)0)
+#endif
 
 float getDistanceToAxe()
 {
@@ -131,6 +313,18 @@ float getDistanceToAxe()
 
 int retina_width, retina_height;
 
+// the default framebuffer is no GL object, its size is estimated from the window
+// every sample has color and depth/stencil, and a multisampled one resolves into front and back buffers
+void trackFramebufferMemory(int width, int height) {
+	GLint samples = 0;
+	glGetIntegerv(GL_SAMPLES, &samples);
+	size_t bytes = gps::textureStorageBytes(GL_SRGB8_ALPHA8, width, height, 1, 1, samples)
+		+ gps::textureStorageBytes(GL_DEPTH24_STENCIL8, width, height, 1, 1, samples);
+	if (samples > 1)
+		bytes += gps::textureStorageBytes(GL_SRGB8_ALPHA8, width, height, 2, 1, 1);
+	gps::trackSurfaceMemory("default framebuffer", bytes, gps::GPU_MEMORY_FRAMEBUFFERS, "window");
+}
+
 void windowResizeCallback(GLFWwindow* window, int width, int height) {
 	fprintf(stdout, "Window resized! New width: %d , and height: %d\n", width, height);
 	//-TODO
@@ -139,16 +333,18 @@ void windowResizeCallback(GLFWwindow* window, int width, int height) {
 
 	myBasicShader.useShaderProgram();
 
-	glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)width / (float)height, 0.1f, 1000.0f);
+	// the global projection is also used for culling, so keep it in sync with the shader
+	projection = glm::perspective(glm::radians(45.0f), (float)width / (float)height, 0.1f, 1000.0f);
 
-	GLint projLoc = glGetUniformLocation(myBasicShader.shaderProgram, "projection");
+	GLint projLoc = glGetUniformLocation(myBasicShader.shaderProgram.get(), "projection");
 	glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
 
 	lightShader.useShaderProgram();
 
-	glUniformMatrix4fv(glGetUniformLocation(lightShader.shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+	glUniformMatrix4fv(glGetUniformLocation(lightShader.shaderProgram.get(), "projection"), 1, GL_FALSE, glm::value_ptr(projection));
 
 	glViewport(0, 0, width, height);
+	trackFramebufferMemory(width, height);
 }
 
 void keyboardCallback(GLFWwindow* window, int key, int scancode, int action, int mode) {
@@ -156,6 +352,21 @@ void keyboardCallback(GLFWwindow* window, int key, int scancode, int action, int
         glfwSetWindowShouldClose(window, GL_TRUE);
     }
 
+	if (key == GLFW_KEY_P && action == GLFW_PRESS)
+		profilerOverlay = !profilerOverlay;
+
+	if (key == GLFW_KEY_R && action == GLFW_PRESS)
+		renderStatsTitle = !renderStatsTitle;
+
+	if (key == GLFW_KEY_M && action == GLFW_PRESS)
+		gps::printGpuMemoryReport();
+
+	if (key == GLFW_KEY_O && action == GLFW_PRESS) {
+		occlusionMode = (OcclusionMode)((occlusionMode + 1) % OCCLUSION_MODE_COUNT);
+		if (pipelined && occlusionMode == OCCLUSION_GPU_QUERIES)
+			occlusionMode = (OcclusionMode)((occlusionMode + 1) % OCCLUSION_MODE_COUNT);
+	}
+
 	if (key >= 0 && key < 1024) {
         if (action == GLFW_PRESS) {
             pressedKeys[key] = true;
@@ -195,15 +406,27 @@ void mouseCallback(GLFWwindow* window, double xpos, double ypos) {
 	if (pitch < -89.0f)
 		pitch = -89.0f;
 
-	myCamera.rotate(pitch, yaw);
-	view = myCamera.getViewMatrix();
-	myBasicShader.useShaderProgram();
-	glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-	normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
-	
+	// the camera turns when the next frame is simulated
 	//myCamera.displayCameraPosition();
 }
 
+// called on the main thread after the events were polled
+void publishInput() {
+	std::lock_guard<std::mutex> lock(inputMutex);
+	memcpy(latestInput.keys, pressedKeys, sizeof(latestInput.keys));
+	latestInput.mouseMoved = !mouse;
+	latestInput.pitch = pitch;
+	latestInput.yaw = yaw;
+	latestInput.occlusionMode = occlusionMode;
+	latestInput.projection = projection;
+	latestInput.time = glfwGetTime();
+}
+
+InputSnapshot takeInput() {
+	std::lock_guard<std::mutex> lock(inputMutex);
+	return latestInput;
+}
+
 // initialize faces for skybox
 void initSkyBoxFaces()
 {
@@ -230,63 +453,52 @@ int fogEnable = 1;
 GLint fogEnableLoc;
 GLfloat fogDensity = 0.05f;
 
-void processMovement() {
-	if (pressedKeys[GLFW_KEY_W]) {
+// camera and scene controls, on the simulation side with the input the frame was started with
+void processMovement(const InputSnapshot& input) {
+	GPS_PROFILE_ZONE("processMovement");
+	if (input.keys[GLFW_KEY_W]) {
 		myCamera.move(gps::MOVE_FORWARD, cameraSpeed);
-		//update view matrix
-        view = myCamera.getViewMatrix();
-        myBasicShader.useShaderProgram();
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-        // compute normal matrix for teapot
-        normalMatrix = glm::mat3(glm::inverseTranspose(view*model));
 	}
 
-	if (pressedKeys[GLFW_KEY_S]) {
+	if (input.keys[GLFW_KEY_S]) {
 		myCamera.move(gps::MOVE_BACKWARD, cameraSpeed);
-        //update view matrix
-        view = myCamera.getViewMatrix();
-        myBasicShader.useShaderProgram();
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-        // compute normal matrix for teapot
-        normalMatrix = glm::mat3(glm::inverseTranspose(view*model));
 	}
 
-	if (pressedKeys[GLFW_KEY_A]) {
+	if (input.keys[GLFW_KEY_A]) {
 		myCamera.move(gps::MOVE_LEFT, cameraSpeed);
-        //update view matrix
-        view = myCamera.getViewMatrix();
-        myBasicShader.useShaderProgram();
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-        // compute normal matrix for teapot
-        normalMatrix = glm::mat3(glm::inverseTranspose(view*model));
 	}
 
-	if (pressedKeys[GLFW_KEY_D]) {
+	if (input.keys[GLFW_KEY_D]) {
 		myCamera.move(gps::MOVE_RIGHT, cameraSpeed);
-        //update view matrix
-        view = myCamera.getViewMatrix();
-        myBasicShader.useShaderProgram();
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-        // compute normal matrix for teapot
-        normalMatrix = glm::mat3(glm::inverseTranspose(view*model));
 	}
 
-    if (pressedKeys[GLFW_KEY_Q]) {
+	if (input.mouseMoved)
+		myCamera.rotate(input.pitch, input.yaw);
+
+    // rotate the whole scene
+    if (input.keys[GLFW_KEY_Q]) {
         angle -= 1.0f;
-        // update model matrix for teapot
-        model = glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::vec3(0, 1, 0));
-        // update normal matrix for teapot
-        normalMatrix = glm::mat3(glm::inverseTranspose(view*model));
     }
 
-    if (pressedKeys[GLFW_KEY_E]) {
+    if (input.keys[GLFW_KEY_E]) {
         angle += 1.0f;
-        // update model matrix for teapot
-        model = glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::vec3(0, 1, 0));
-        // update normal matrix for teapot
-        normalMatrix = glm::mat3(glm::inverseTranspose(view*model));
     }
 
+	// increase the intensity of fog
+	if (input.keys[GLFW_KEY_H])
+	{
+		fogDensity = min(fogDensity + 0.01f, 1.0f);
+	}
+
+	// decrease the intensity of fog
+	if (input.keys[GLFW_KEY_J])
+	{
+		fogDensity = max(fogDensity - 0.01f, 0.0f);
+	}
+}
+
+// keys that change GL state, on the render thread
+void processRenderKeys() {
 	// line view
 	if (pressedKeys[GLFW_KEY_1]) {
 		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -307,7 +519,7 @@ void processMovement() {
 
 		myBasicShader.useShaderProgram();
 		fogEnable = 1;
-		fogEnableLoc = glGetUniformLocation(myBasicShader.shaderProgram, "fogEnable");
+		fogEnableLoc = glGetUniformLocation(myBasicShader.shaderProgram.get(), "fogEnable");
 		glUniform1i(fogEnableLoc, fogEnable);
 
 	}
@@ -316,26 +528,18 @@ void processMovement() {
 	if (pressedKeys[GLFW_KEY_G]) {
 		myBasicShader.useShaderProgram();
 		fogEnable = 0;
-		fogEnableLoc = glGetUniformLocation(myBasicShader.shaderProgram, "fogEnable");
+		fogEnableLoc = glGetUniformLocation(myBasicShader.shaderProgram.get(), "fogEnable");
 		glUniform1i(fogEnableLoc, fogEnable);
 
 	}//*/
-
-	// increase the intensity of fog
-	if (pressedKeys[GLFW_KEY_H])
-	{
-		fogDensity = min(fogDensity + 0.01f, 1.0f);
-	}
-
-	// decrease the intensity of fog
-	if (pressedKeys[GLFW_KEY_J])
-	{
-		fogDensity = max(fogDensity - 0.01f, 0.0f);
-	}
 }
 
 void initOpenGLWindow() {
-    myWindow.Create(1024, 768, "OpenGL Project Core");
+    myWindow.Create(1024, 768, "OpenGL Project Core", benchmarkFrames > 0);
+	gps::installDebugOutput(debugSeverity);
+	int width, height;
+	glfwGetFramebufferSize(myWindow.getWindow(), &width, &height);
+	trackFramebufferMemory(width, height);
 }
 
 void setWindowCallbacks() {
@@ -356,17 +560,61 @@ void initOpenGLState() {
 }
 
 void initModels() {
-    teapot.LoadModel("models/teapot/teapot20segUT.obj");
-	ground.LoadModel("models/ground/secondtry.obj");
-	axe.LoadModel("models/axe/axe.obj");
-	woodLog1.LoadModel("models/woodLog1/woodLog1.obj");
-	woodLog2.LoadModel("models/woodLog2/woodLog2.obj");
+	GPS_PROFILE_ZONE("initModels");
+    teapot.LoadModel("models/teapot/teapot20segUT.obj", geometryArena);
+	// the ground keeps its geometry, its big meshes are the occluders
+	ground.LoadModel("models/ground/secondtry.obj", geometryArena, gps::LOAD_KEEP_GEOMETRY);
+	axe.LoadModel("models/axe/axe.obj", geometryArena);
+	woodLog1.LoadModel("models/woodLog1/woodLog1.obj", geometryArena);
+	woodLog2.LoadModel("models/woodLog2/woodLog2.obj", geometryArena);
+
+	teapot.RegisterMaterials(materialTable);
+	ground.RegisterMaterials(materialTable);
+	axe.RegisterMaterials(materialTable);
+	woodLog1.RegisterMaterials(materialTable);
+	woodLog2.RegisterMaterials(materialTable);
+	materialTable.upload();
+}
+
+void initSceneGraph() {
+	GPS_PROFILE_ZONE("initSceneGraph");
+	const glm::vec3 axePivot(-0.809835f, 0.180243f, 1.829416f);
+	const glm::vec3 woodLog1Pivot(-0.723645f, 0.092108f, 1.805677f);
+	const glm::vec3 woodLog2Pivot(-0.731435f, 0.092108f, 1.796738f);
+
+	sceneRootNode = sceneGraph.addNode();
+	sceneGraph.setRotation(sceneRootNode, glm::angleAxis(glm::radians(angle), glm::vec3(0, 1, 0)));
+
+	teapotNode = sceneGraph.addNode(sceneRootNode);
+	sceneGraph.setTranslation(teapotNode, glm::vec3(0.0f, -1.0f, 0.0f));
+
+	groundNode = sceneGraph.addNode(sceneRootNode);
+
+	// the models are modelled in place, so each one is moved back by the pivot it rotates around
+	axePivotNode = sceneGraph.addNode(sceneRootNode);
+	sceneGraph.setTranslation(axePivotNode, axePivot);
+	axeNode = sceneGraph.addNode(axePivotNode);
+	sceneGraph.setTranslation(axeNode, -axePivot);
+
+	woodLog1PivotNode = sceneGraph.addNode(sceneRootNode);
+	sceneGraph.setTranslation(woodLog1PivotNode, woodLog1Pivot);
+	woodLog1Node = sceneGraph.addNode(woodLog1PivotNode);
+	sceneGraph.setTranslation(woodLog1Node, -woodLog1Pivot);
+
+	woodLog2PivotNode = sceneGraph.addNode(sceneRootNode);
+	sceneGraph.setTranslation(woodLog2PivotNode, woodLog2Pivot);
+	woodLog2Node = sceneGraph.addNode(woodLog2PivotNode);
+	sceneGraph.setTranslation(woodLog2Node, -woodLog2Pivot);
+
+	sceneGraph.update();
 }
 
 void initShaders() {
+	GPS_PROFILE_ZONE("initShaders");
 	myBasicShader.loadShader(
-        "shaders/basic.vert",
+        indirectDrawing ? "shaders/basicIndirect.vert" : "shaders/basic.vert",
         "shaders/basic.frag");
+	gps::MaterialTable::attachShader(myBasicShader);
 }
 
 void initSkyBoxShader()
@@ -376,74 +624,258 @@ void initSkyBoxShader()
 	skyBoxShader.useShaderProgram();
 
 	view = myCamera.getViewMatrix();
-	glUniformMatrix4fv(glGetUniformLocation(skyBoxShader.shaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
+	glUniformMatrix4fv(glGetUniformLocation(skyBoxShader.shaderProgram.get(), "view"), 1, GL_FALSE, glm::value_ptr(view));
+}
+
+void initRenderQueue() {
+	renderQueue = gps::RenderQueue();
+	basicProgramIndex = renderQueue.addProgram(myBasicShader, indirectDrawing);
+	skyBoxProgramIndex = renderQueue.addProgram(skyBoxShader);
+	// depths are quantized up to the far plane
+	renderQueue.setDepthRange(20.0f);
+	renderQueue.setProfiler(&gpuProfiler);
 }
 
 void initUniforms() {
 	myBasicShader.useShaderProgram();
 
-    // create model matrix for teapot
-    model = glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
-	modelLoc = glGetUniformLocation(myBasicShader.shaderProgram, "model");
+	modelLoc = glGetUniformLocation(myBasicShader.shaderProgram.get(), "model");
 
 	// get view matrix for current camera
 	view = myCamera.getViewMatrix();
-	viewLoc = glGetUniformLocation(myBasicShader.shaderProgram, "view");
+	viewLoc = glGetUniformLocation(myBasicShader.shaderProgram.get(), "view");
 	// send view matrix to shader
     glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
 
-    // compute normal matrix for teapot
-    normalMatrix = glm::mat3(glm::inverseTranspose(view*model));
-	normalMatrixLoc = glGetUniformLocation(myBasicShader.shaderProgram, "normalMatrix");
+	normalMatrixLoc = glGetUniformLocation(myBasicShader.shaderProgram.get(), "normalMatrix");
 
 	// create projection matrix
 	projection = glm::perspective(glm::radians(45.0f),
                                (float)myWindow.getWindowDimensions().width / (float)myWindow.getWindowDimensions().height,
                                0.1f, 20.0f);
-	projectionLoc = glGetUniformLocation(myBasicShader.shaderProgram, "projection");
+	projectionLoc = glGetUniformLocation(myBasicShader.shaderProgram.get(), "projection");
 	// send projection matrix to shader
 	glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));	
 
 	//set the light direction (direction towards the light)
 	lightDir = glm::vec3(0.0f, 1.0f, 1.0f);
-	lightDirLoc = glGetUniformLocation(myBasicShader.shaderProgram, "lightDir");
+	lightDirLoc = glGetUniformLocation(myBasicShader.shaderProgram.get(), "lightDir");
 	// send light dir to shader
 	glUniform3fv(lightDirLoc, 1, glm::value_ptr(lightDir));
+	lightDirEyeLoc = glGetUniformLocation(myBasicShader.shaderProgram.get(), "lightDirEye");
 
 	//set light color
 	lightColor = glm::vec3(1.0f, 1.0f, 1.0f); //white light
-	lightColorLoc = glGetUniformLocation(myBasicShader.shaderProgram, "lightColor");
+	lightColorLoc = glGetUniformLocation(myBasicShader.shaderProgram.get(), "lightColor");
 	// send light color to shader
 	glUniform3fv(lightColorLoc, 1, glm::value_ptr(lightColor));
 
 }
 
-void renderTeapot(gps::Shader shader) {
-    // select active shader program
-    shader.useShaderProgram();
+// light direction in eye space, computed once per frame instead of once per fragment
+void updateLightDirEye() {
+	lightDirEye = glm::normalize(glm::vec3(view * glm::vec4(lightDir, 0.0f)));
+	myBasicShader.useShaderProgram();
+	glUniform3fv(lightDirEyeLoc, 1, glm::value_ptr(lightDirEye));
+	gps::countProgramBind();
+	gps::countUniformBytes(sizeof(glm::vec3));
+}
 
-	model = glm::translate(model, glm::vec3(0.0f, -1.0f, 0.0f));
+void addSceneModel(const gps::Model3D& model3D, gps::NodeId node) {
+	for (size_t i = 0; i < model3D.getDrawPackets().size(); i++) {
+		SceneEntry entry = { &model3D, node, i };
+		sceneEntries.push_back(entry);
+	}
+}
 
-    //send teapot model matrix data to shader
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+// recomputes the world bounds of the meshes whose node moved (or of all of them)
+// every entry writes only its own bounds, so chunks of them can go to different threads
+void updateSceneBounds(bool all) {
+	GPS_PROFILE_ZONE("updateSceneBounds");
+	jobSystem.parallelFor("scene bounds", sceneEntries.size(), 1024, [all](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			const SceneEntry& entry = sceneEntries[i];
+			if (all || sceneGraph.worldChanged(entry.node))
+				sceneBounds.set(i, entry.model->getMeshBounds()[entry.mesh], sceneGraph.getWorldMatrix(entry.node));
+		}
+	});
+}
 
-    //send teapot normal matrix data to shader
-    glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+void initSceneEntries() {
+	GPS_PROFILE_ZONE("initSceneEntries");
+	sceneEntries.clear();
+	addSceneModel(teapot, teapotNode);
+	addSceneModel(ground, groundNode);
+	addSceneModel(axe, axeNode);
+	addSceneModel(woodLog1, woodLog1Node);
+	addSceneModel(woodLog2, woodLog2Node);
+
+	sceneGraph.update();
+	sceneBounds.resize(sceneEntries.size());
+	updateSceneBounds(true);
+	visibleEntries.reserve(sceneEntries.size());
+}
 
-    // draw teapot
-    teapot.Draw(shader);
-	model = glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
-	modelLoc = glGetUniformLocation(myBasicShader.shaderProgram, "model");
+// the meshes of the ground big enough to hide a good part of the scene
+void initOccluders() {
+	GPS_PROFILE_ZONE("initOccluders");
+	const float minOccluderSize = 0.5f;
+
+	occlusionCuller.clearOccluders();
+	const std::vector<gps::Mesh>& meshes = ground.getMeshes();
+	for (size_t i = 0; i < meshes.size(); i++) {
+		const gps::Mesh& mesh = meshes[i];
+		glm::vec3 size = mesh.getBounds().max - mesh.getBounds().min;
+		bool tooSmall = size.x < minOccluderSize && size.y < minOccluderSize && size.z < minOccluderSize;
+		if (tooSmall || mesh.vertices.empty())
+			continue;
+
+		std::vector<glm::vec3> positions(mesh.vertices.size());
+		for (size_t v = 0; v < positions.size(); v++)
+			positions[v] = mesh.vertices[v].Position;
+
+		std::vector<uint32_t> indices(mesh.indices.begin(), mesh.indices.end());
+		if (indices.empty()) {
+			for (size_t v = 0; v < positions.size(); v++)
+				indices.push_back((uint32_t)v);
+		}
+
+		occlusionCuller.addOccluder(positions, indices, sceneGraph.getWorldMatrix(groundNode));
+	}
 }
 
-void renderGround(gps::Shader shader) {
-	shader.useShaderProgram();
+// culls one chunk of the scene against the frustum and the occluders and records what is left
+// runs on any thread: it only reads the scene and writes its own chunk and command list
+void recordChunk(FramePacket& packet, size_t chunk, size_t begin, size_t end, const gps::Frustum& frustum) {
+	RecordChunk& result = recordChunks[chunk];
+	result.inFrustum = (unsigned int)gps::cullBoundsRange(frustum, sceneBounds, begin, end, result.visible);
+	result.occluded = 0;
+	if (packet.occlusionMode == OCCLUSION_CPU)
+		result.occluded = (unsigned int)occlusionCuller.cull(sceneBounds, result.visible);
+
+	gps::RenderCommandList& commands = packet.commandLists[chunk];
+	commands.begin(sceneGraph, packet.view, renderQueue.getDepthRange());
+	for (size_t i = 0; i < result.visible.size(); i++) {
+		uint32_t index = result.visible[i];
+		const SceneEntry& entry = sceneEntries[index];
+		float depth = -(packet.view * glm::vec4(sceneBounds.getCenter(index), 1.0f)).z;
+		GLuint condition = packet.occlusionMode == OCCLUSION_GPU_QUERIES ? occlusionQueries.getCondition(index) : 0;
+		commands.push(gps::PASS_OPAQUE, basicProgramIndex, entry.model->getDrawPackets()[entry.mesh], entry.node, depth, condition);
+	}
+}
 
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+// culls the scene against the camera frustum and the occluders, then records what is left into the packet
+// chunks are culled and recorded on the job system, the render thread appends them to the render queue
+void recordVisibleMeshes(FramePacket& packet) {
+	GPS_PROFILE_ZONE("recordVisibleMeshes");
+	glm::mat4 viewProjection = packet.projection * packet.view;
+	gps::Frustum frustum = gps::extractFrustum(viewProjection);
 
-	glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+	if (sceneGraph.worldChanged(groundNode)) {
+		for (size_t i = 0; i < occlusionCuller.getOccluderCount(); i++)
+			occlusionCuller.setOccluderTransform(i, sceneGraph.getWorldMatrix(groundNode));
+	}
 
-	ground.Draw(shader);
+	if (packet.occlusionMode == OCCLUSION_CPU)
+		occlusionCuller.render(viewProjection);
+	else if (packet.occlusionMode == OCCLUSION_GPU_QUERIES)
+		occlusionQueries.beginFrame(sceneEntries.size());
+
+	// lists are kept between frames so their buffers are only allocated once
+	size_t chunkCount = (sceneEntries.size() + RECORD_CHUNK_SIZE - 1) / RECORD_CHUNK_SIZE;
+	if (recordChunks.size() < chunkCount)
+		recordChunks.resize(chunkCount);
+	if (packet.commandLists.size() < chunkCount)
+		packet.commandLists.resize(chunkCount);
+	packet.commandListCount = chunkCount;
+	jobSystem.parallelFor("record scene", sceneEntries.size(), RECORD_CHUNK_SIZE, [&packet, &frustum](size_t begin, size_t end) {
+		recordChunk(packet, begin / RECORD_CHUNK_SIZE, begin, end, frustum);
+	});
+
+	gps::CullStats& stats = packet.cullStats;
+	stats.tested = (unsigned int)sceneEntries.size();
+	stats.culled = stats.tested;
+	stats.occluded = 0;
+	visibleEntries.clear();
+	for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+		stats.culled -= recordChunks[chunk].inFrustum;
+		stats.occluded += recordChunks[chunk].occluded;
+		visibleEntries.insert(visibleEntries.end(), recordChunks[chunk].visible.begin(), recordChunks[chunk].visible.end());
+	}
+	// the GPU skips the hidden draws itself, the count comes from queries that already finished
+	if (packet.occlusionMode == OCCLUSION_GPU_QUERIES)
+		stats.occluded = occlusionQueries.getOccludedCount();
+	stats.visible = (unsigned int)visibleEntries.size();
+}
+
+// scatters copies of a wood log over the ground, they never go through the render queue
+void initScatter() {
+	GPS_PROFILE_ZONE("initScatter");
+	if (scatterCount <= 0)
+		return;
+	if (!gps::GpuCuller::isSupported()) {
+		std::cout << "--scatter needs GL 4.3 and ARB_shader_draw_parameters, skipped" << std::endl;
+		return;
+	}
+
+	gpuCuller.init();
+	GLuint logPrototype = gpuCuller.addPrototype(woodLog1);
+	// a single detail level, past the fog nothing is drawn
+	gpuCuller.addLod(logPrototype, woodLog1, 15.0f);
+
+	// the log is modelled where it lies in the scene, move its center to the origin first
+	const std::vector<gps::Bounds>& logBounds = woodLog1.getMeshBounds();
+	glm::vec3 logCenter = logBounds.empty() ? glm::vec3(0.0f) : (logBounds[0].min + logBounds[0].max) * 0.5f;
+	glm::mat4 toOrigin = glm::translate(glm::mat4(1.0f), glm::vec3(-logCenter.x, 0.0f, -logCenter.z));
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(-20.0f, 20.0f);
+	std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+	for (int i = 0; i < scatterCount; i++) {
+		glm::mat4 world = glm::translate(glm::mat4(1.0f), glm::vec3(position(random), 0.0f, position(random)));
+		world = glm::rotate(world, angle(random), glm::vec3(0.0f, 1.0f, 0.0f));
+		gpuCuller.addInstance(logPrototype, world * toOrigin);
+	}
+	gpuCuller.upload();
+
+	instancedShader.loadShader("shaders/basicInstanced.vert", "shaders/basic.frag");
+	gps::MaterialTable::attachShader(instancedShader);
+}
+
+// culls the scattered instances on the GPU, against the CPU depth pyramid when it was rendered for
+// this frame; with the pipeline the simulation is already rendering it for the next one
+void cullScatter(const FramePacket& packet) {
+	if (gpuCuller.getInstanceCount() == 0)
+		return;
+
+	gps::Frustum frustum = gps::extractFrustum(packet.projection * packet.view);
+	bool useHiZ = !pipelined && packet.occlusionMode == OCCLUSION_CPU;
+	gpuCuller.cull(frustum, packet.cameraPosition, useHiZ ? &occlusionCuller : NULL);
+}
+
+void drawScatter() {
+	if (gpuCuller.getInstanceCount() == 0)
+		return;
+
+	GLuint program = instancedShader.shaderProgram.get();
+	instancedShader.useShaderProgram();
+	glUniformMatrix4fv(glGetUniformLocation(program, "view"), 1, GL_FALSE, glm::value_ptr(view));
+	glUniformMatrix4fv(glGetUniformLocation(program, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+	glUniform3fv(glGetUniformLocation(program, "lightDirEye"), 1, glm::value_ptr(lightDirEye));
+	glUniform3fv(glGetUniformLocation(program, "lightColor"), 1, glm::value_ptr(lightColor));
+	glUniform1i(glGetUniformLocation(program, "fogEnable"), fogEnable);
+	gps::countProgramBind();
+	gps::countUniformBytes(2 * sizeof(glm::mat4) + 2 * sizeof(glm::vec3) + sizeof(GLint));
+	gpuCuller.draw(instancedShader);
+}
+
+// draws the boxes of the meshes queued this frame inside occlusion queries, for the next frame
+// only without the pipeline, so the bounds are still the ones of this frame
+void issueOcclusionQueries(const FramePacket& packet) {
+	if (packet.occlusionMode != OCCLUSION_GPU_QUERIES)
+		return;
+
+	occlusionQueries.issue(sceneBounds, visibleEntries, packet.projection * packet.view, packet.cameraPosition);
 }
 
 GLfloat axeAngle = 0.0f;
@@ -470,153 +902,641 @@ int inAxeRange()
 	return 0;
 }
 
-void renderAxe(gps::Shader shader) {
-	// select active shader program
-	shader.useShaderProgram();
+// rotations of the axe and the logs after the last step
+GLfloat axeRotation = 0.0f;
+GLfloat logRotation = 0.0f;
 
-	//send teapot model matrix data to shader
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+// the axe swings while the camera is close to it, the logs split at the end of each swing
+void animationAxe()
+{
+	bool axeMoving = inAxeRange();
 
-	//send teapot normal matrix data to shader
-	glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+	axeRotation = axeAngle;
+	if (axeMoving)
+		axeAngle += 0.005f;
 
-	// draw teapot
-	axe.Draw(shader);
+	logRotation = 0.0f;
+	if (axeAngle >= 0.4f) {
+		logRotation = woodLogAngle;
+		woodLogAngle += 0.02167f;
+	}
 }
 
-void animationAxe()
-{
-	// select active shader program
-	myBasicShader.useShaderProgram();
-
-	model = glm::translate(model, glm::vec3(-0.809835f, 0.180243f, 1.829416f) - glm::vec3(0.0f, 0.0f, 0.0f));
-	model = glm::rotate(model, -axeAngle, glm::vec3(0, 0, 1));
-	model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f) - glm::vec3(-0.809835f, 0.180243f, 1.829416f));
+// the simulation advances in fixed steps of 1/60 s, the speeds above are per step; a frame
+// shows the state between the last two steps, so motion is the same at any frame rate
+const double SIMULATION_STEP = 1.0 / 60.0;
+// a longer frame (a stall, a breakpoint) is not caught up with, the simulation slows down instead
+const double MAX_FRAME_TIME = 0.25;
+
+// what a frame interpolates between two steps
+struct SimulationState {
+	float axeRotation;
+	float logRotation;
+	float sceneAngle;
+	glm::vec3 cameraPosition;
+	glm::vec3 cameraFront;
+};
+
+bool simulationStarted = false;
+double lastSimulationTime = 0.0;
+double simulationAccumulator = 0.0;
+// steps run so far, the clock of camera recordings and replays
+long simulationSteps = 0;
+SimulationState previousState, currentState;
+// last state given to the scene graph, nodes are only touched when it changes
+SimulationState appliedState;
+
+SimulationState captureSimulationState() {
+	SimulationState state;
+	state.axeRotation = axeRotation;
+	state.logRotation = logRotation;
+	state.sceneAngle = angle;
+	myCamera.getCameraPosition(&state.cameraPosition.x, &state.cameraPosition.y, &state.cameraPosition.z);
+	state.cameraFront = myCamera.getCameraFrontDirection();
+	return state;
+}
 
-	glUniformMatrix4fv(glGetUniformLocation(myBasicShader.shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
+SimulationState interpolateSimulationState(const SimulationState& from, const SimulationState& to, float alpha) {
+	SimulationState state;
+	// the swing restarts from 0, sweeping back over it would show a frame of the axe going backwards
+	state.axeRotation = to.axeRotation < from.axeRotation ? to.axeRotation : glm::mix(from.axeRotation, to.axeRotation, alpha);
+	state.logRotation = to.logRotation < from.logRotation ? to.logRotation : glm::mix(from.logRotation, to.logRotation, alpha);
+	state.sceneAngle = glm::mix(from.sceneAngle, to.sceneAngle, alpha);
+	state.cameraPosition = glm::mix(from.cameraPosition, to.cameraPosition, alpha);
+	state.cameraFront = glm::normalize(glm::mix(from.cameraFront, to.cameraFront, alpha));
+	return state;
+}
 
-	axe.Draw(myBasicShader);
-	axeAngle += 0.005f;
-	model = glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
-	modelLoc = glGetUniformLocation(myBasicShader.shaderProgram, "model");
+void applySimulationState(const SimulationState& state) {
+	if (state.sceneAngle != appliedState.sceneAngle)
+		sceneGraph.setRotation(sceneRootNode, glm::angleAxis(glm::radians(state.sceneAngle), glm::vec3(0, 1, 0)));
+	if (state.axeRotation != appliedState.axeRotation)
+		sceneGraph.setRotation(axePivotNode, glm::angleAxis(-state.axeRotation, glm::vec3(0, 0, 1)));
+	if (state.logRotation != appliedState.logRotation) {
+		sceneGraph.setRotation(woodLog1PivotNode, glm::angleAxis(state.logRotation, glm::vec3(1, 0, 0)));
+		sceneGraph.setRotation(woodLog2PivotNode, glm::angleAxis(-state.logRotation, glm::vec3(1, 0, 0)));
+	}
+	appliedState = state;
 }
 
-void animationWoodLogs()
-{
-	//wl1 -0.723645 0.203855 1.805677
-	//wl2 -0.731435 0.092108 1.796738
+// one step of a camera replay: the recorded keys drive the scene controls, the spline the camera
+void replayCameraStep(const InputSnapshot& input, double time) {
+	const std::vector<gps::CameraInputEvent>& events = cameraReplay.getEvents();
+	for (; cameraReplayEvent < events.size() && events[cameraReplayEvent].time <= time; cameraReplayEvent++) {
+		const gps::CameraInputEvent& event = events[cameraReplayEvent];
+		if (event.type == gps::CAMERA_INPUT_KEY && event.key >= 0 && event.key < 1024 && event.action != GLFW_REPEAT)
+			cameraReplayKeys[event.key] = event.action == GLFW_PRESS;
+	}
 
-	//WOOD LOG Animation 1
-	// select active shader program
-	myBasicShader.useShaderProgram();
+	InputSnapshot replayInput = input;
+	memcpy(replayInput.keys, cameraReplayKeys, sizeof(replayInput.keys));
+	replayInput.mouseMoved = false;
+	processMovement(replayInput);
 
-	//glm::mat4 modelAux = model;
-	model = glm::translate(model, glm::vec3(-0.723645f, 0.092108f, 1.805677f) - glm::vec3(0.0f, 0.0f, 0.0f));
-	model = glm::rotate(model, woodLogAngle, glm::vec3(1, 0, 0));
-	model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f) - glm::vec3(-0.723645f, 0.092108f, 1.805677f));
+	glm::vec3 position, front;
+	cameraReplay.sample(time, position, front);
+	myCamera.setCameraPosition(position);
+	myCamera.setCameraFrontDirection(front);
 
-	glUniformMatrix4fv(glGetUniformLocation(myBasicShader.shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-	
-	woodLog1.Draw(myBasicShader);
-	model = glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
-	modelLoc = glGetUniformLocation(myBasicShader.shaderProgram, "model");
+	if (time >= cameraReplay.getDuration())
+		glfwSetWindowShouldClose(myWindow.getWindow(), GL_TRUE);
+}
 
-	//WOOD LOG Animation 2
-	myBasicShader.useShaderProgram();
+// adds an event for every key whose state differs from the one the last recorded step saw
+void recordCameraKeys(const InputSnapshot& input, double time) {
+	for (int key = 0; key < 1024; key++) {
+		if (input.keys[key] != cameraRecordKeys[key]) {
+			cameraRecording.addKeyEvent(time, key, input.keys[key] ? GLFW_PRESS : GLFW_RELEASE);
+			cameraRecordKeys[key] = input.keys[key];
+		}
+	}
+}
 
-	//glm::mat4 modelAux = model;
-	model = glm::translate(model, glm::vec3(-0.731435f, 0.092108f, 1.796738f) - glm::vec3(0.0f, 0.0f, 0.0f));
-	model = glm::rotate(model, -woodLogAngle, glm::vec3(1, 0, 0));
-	model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f) - glm::vec3(-0.731435f, 0.092108f, 1.796738f));
+// runs the fixed steps for the time since the last frame and applies the interpolated state
+SimulationState advanceSimulation(const InputSnapshot& input) {
+	GPS_PROFILE_ZONE("advanceSimulation");
+	if (!simulationStarted) {
+		lastSimulationTime = input.time;
+		previousState = currentState = appliedState = captureSimulationState();
+		simulationStarted = true;
+		// the spline starts at the view the recording started from
+		if (cameraRecordFile)
+			cameraRecording.addKeyframe(0.0, currentState.cameraPosition, currentState.cameraFront);
+	}
+
+	double elapsed = input.time - lastSimulationTime;
+	lastSimulationTime = input.time;
+	simulationAccumulator += elapsed < MAX_FRAME_TIME ? elapsed : MAX_FRAME_TIME;
+
+	while (simulationAccumulator >= SIMULATION_STEP) {
+		previousState = currentState;
+		simulationSteps++;
+		if (replayingCamera)
+			replayCameraStep(input, simulationSteps * SIMULATION_STEP);
+		else {
+			// stamped with the step that uses them, replay applies them before the same step
+			if (cameraRecordFile)
+				recordCameraKeys(input, simulationSteps * SIMULATION_STEP);
+			processMovement(input);
+		}
+		animationAxe();
+		currentState = captureSimulationState();
+		if (cameraRecordFile && simulationSteps % CAMERA_KEYFRAME_STEPS == 0)
+			cameraRecording.addKeyframe(simulationSteps * SIMULATION_STEP, currentState.cameraPosition, currentState.cameraFront);
+		simulationAccumulator -= SIMULATION_STEP;
+	}
 
-	glUniformMatrix4fv(glGetUniformLocation(myBasicShader.shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-	
-	woodLog2.Draw(myBasicShader);
-	model = glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
-	modelLoc = glGetUniformLocation(myBasicShader.shaderProgram, "model");
+	SimulationState state = interpolateSimulationState(previousState, currentState, (float)(simulationAccumulator / SIMULATION_STEP));
+	applySimulationState(state);
+	return state;
+}
 
-	woodLogAngle += 0.02167f;
+// simulation side of a frame: input, animation and culling, no GL calls unless GPU queries are on
+void simulateFrame(FramePacket& packet) {
+	GPS_PROFILE_ZONE("simulateFrame");
+	gps::AllocationScope allocationScope(gps::ALLOCATION_SIMULATION);
+	// scratch buffers of the simulation thread come from the frame arena, the occluder clip buffers for now
+	// the culling jobs have no scope and write into lists kept between frames instead
+	packet.frame = ++simulatedFrames;
+	gps::resetFrameArenas(packet.frame);
+	gps::FrameAllocationScope frameScope(packet.frame);
+	packet.simulateStart = glfwGetTime();
+	InputSnapshot input = takeInput();
+	packet.inputTime = input.time;
+	packet.occlusionMode = input.occlusionMode;
+	if (pipelined && packet.occlusionMode == OCCLUSION_GPU_QUERIES)
+		packet.occlusionMode = OCCLUSION_CPU;
+
+	//move the camera, animate the axe and wood logs, then refresh the world matrices of whatever moved
+	SimulationState state = advanceSimulation(input);
+	sceneGraph.update();
+	updateSceneBounds(false);
+
+	packet.view = glm::lookAt(state.cameraPosition, state.cameraPosition + state.cameraFront, myCamera.getCameraUpDirection());
+	packet.projection = input.projection;
+	packet.cameraPosition = state.cameraPosition;
+
+	//record the visible part of the scene, the queue sorts it by state and front to back
+	recordVisibleMeshes(packet);
+	packet.simulateTime = (float)((glfwGetTime() - packet.simulateStart) * 1000.0);
 }
 
-void renderWoodLog1(gps::Shader shader) {
-	// select active shader program
-	shader.useShaderProgram();
+// render side of a frame, everything it reads about the scene comes from the packet
+void renderFrame(const FramePacket& packet) {
+	GPS_PROFILE_ZONE("renderFrame");
+	gps::AllocationScope allocationScope(gps::ALLOCATION_RENDERER);
+	gps::beginRenderStatsFrame();
+	gpuProfiler.beginFrame();
+	gpuProfiler.beginScope("frame");
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	//send teapot model matrix data to shader
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+	processRenderKeys();
 
-	//send teapot normal matrix data to shader
-	glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+	//view matrix to shader
+	view = packet.view;
+	myBasicShader.useShaderProgram();
+	glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
+	gps::countProgramBind();
+	gps::countUniformBytes(sizeof(glm::mat4));
+	updateLightDirEye();
+	skyBox.UpdateUniforms(skyBoxShader, view, projection);
 
-	// draw teapot
-	woodLog1.Draw(shader);
+	renderQueue.clear();
+	for (size_t i = 0; i < packet.commandListCount; i++)
+		renderQueue.append(packet.commandLists[i]);
+
+	//skybox last, it only fills what the scene left uncovered
+	renderQueue.push(gps::PASS_SKY, skyBoxProgramIndex, skyBox.GetDrawPacket(), gps::NO_PARENT, 0.0f);
+	{
+		gps::GpuProfileScope scope(gpuProfiler, "scatter cull");
+		cullScatter(packet);
+	}
+
+	// pushed draws have no node, so the scene graph is not read while the simulation moves it
+	{
+		gps::GpuProfileScope scope(gpuProfiler, "scene");
+		renderQueue.submit(sceneGraph, view);
+	}
+	{
+		gps::GpuProfileScope scope(gpuProfiler, "scatter draw");
+		drawScatter();
+	}
+	{
+		gps::GpuProfileScope scope(gpuProfiler, "occlusion queries");
+		issueOcclusionQueries(packet);
+	}
+	cullStats = packet.cullStats;
+	gpuProfiler.endScope();
+
+	if (profilerOverlay) {
+		WindowDimensions dimensions = myWindow.getWindowDimensions();
+		gpuProfiler.drawOverlay(dimensions.width, dimensions.height);
+	}
+	gpuProfiler.endFrame();
+	gps::endRenderStatsFrame();
 }
 
-void renderWoodLog2(gps::Shader shader) {
-	// select active shader program
-	shader.useShaderProgram();
+// one frame without the pipeline
+void renderScene() {
+	GPS_PROFILE_ZONE("renderScene");
+	simulateFrame(framePackets[0]);
+	renderFrame(framePackets[0]);
+}
 
-	//model = glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::vec3(0, 1, 0));
+void simulationLoop() {
+	gps::setProfileThreadName("simulation");
+	while (true) {
+		int packet = framePipeline.acquireForSimulation();
+		if (packet < 0)
+			break;
+		simulateFrame(framePackets[packet]);
+		framePipeline.publish(packet, framePackets[packet].inputTime);
+	}
+}
 
+// what the flight recorder keeps of the frame just rendered from packet, besides its times
+// the GPU time of an older frame came back while this one started
+void recordFlightDetails(gps::FlightFrame& flight, const FramePacket& packet) {
+	flight.frame = gpuProfiler.getFrame();
+	flight.simulateStart = packet.simulateStart;
+	flight.simulateTime = packet.simulateTime;
+	flight.gpuTime = -1.0f;
+	const gps::RenderQueueStats& stats = renderQueue.getStats();
+	flight.draws = stats.draws;
+	flight.drawCalls = stats.drawCalls;
+
+	unsigned int resolvedFrame;
+	float gpuTime;
+	if (gpuProfiler.getLastResolved("frame", resolvedFrame, gpuTime))
+		flightRecorder.setGpuTime(resolvedFrame, gpuTime);
+}
 
-	//model = glm::translate(model, glm::vec3(0.0f, -0.01f, 0.0f));
+// shows the draw statistics of the last frame in the window title, once a second
+void updateStatsTitle() {
+	static double lastUpdate = 0.0;
+	double now = glfwGetTime();
+	if (now - lastUpdate < 1.0)
+		return;
+	lastUpdate = now;
+
+	const gps::RenderQueueStats& stats = renderQueue.getStats();
+	gps::FramePipelineStats frames = framePipeline.getStats();
+	framePipeline.resetStats();
+	char title[384];
+	int length = snprintf(title, sizeof(title), "OpenGL Project Core | %.1f fps | latency %.1f ms (max %.1f)%s",
+		frames.framesPerSecond, frames.averageLatency, frames.maxLatency, pipelined ? " pipelined" : "");
+	if (profilerOverlay) {
+		// average GPU ms of every scope, in the order of the overlay bars
+		for (size_t i = 0; i < gpuProfiler.getScopeCount() && length < (int)sizeof(title); i++) {
+			gps::GpuScopeStats scope = gpuProfiler.getScopeStats(i);
+			length += snprintf(title + length, sizeof(title) - length, " | %s %.2f ms", scope.name, scope.average);
+		}
+	} else if (renderStatsTitle) {
+		const gps::RenderStats& render = gps::getRenderStats();
+		length += snprintf(title + length, sizeof(title) - length, " | calls %u | triangles %llu | vertices %llu | binds program %u VAO %u texture %u | uniforms %.1f KB | uploads buffer %.1f KB texture %.1f KB",
+			render.drawCalls, render.triangles, render.vertices, render.programBinds, render.vaoBinds, render.textureBinds,
+			render.uniformBytes / 1024.0, render.bufferBytes / 1024.0, render.textureBytes / 1024.0);
+		if (gps::isAllocationTrackingEnabled() && length < (int)sizeof(title))
+			snprintf(title + length, sizeof(title) - length, " | allocations %u", frameAllocations);
+	} else {
+		snprintf(title + length, sizeof(title) - length, " | draws %u in %u calls | culled %u/%u | occluded %u | program switches %u | texture binds %u | VAO binds %u",
+			stats.draws, stats.drawCalls, cullStats.culled, cullStats.tested, cullStats.occluded, stats.programSwitches, stats.textureBinds, stats.vaoBinds);
+	}
+	glfwSetWindowTitle(myWindow.getWindow(), title);
+}
 
+// renders the scene a number of times and returns the average GPU time of a frame, in ms
+// results are read back the way runSceneBenchmark does it, a few frames late, so the GPU never drains
+double measureSceneGpuTime(int frames) {
+	const int queryCount = 4;
+	gps::GLQuery timeQueries[queryCount];
+	for (int i = 0; i < queryCount; i++)
+		timeQueries[i] = gps::GLQuery::create();
+
+	GLuint64 totalTime = 0;
+	int nextResult = 0;
+	auto readGpuTime = [&](int frame) {
+		GLuint64 frameTime = 0;
+		glGetQueryObjectui64v(timeQueries[frame % queryCount].get(), GL_QUERY_RESULT, &frameTime);
+		totalTime += frameTime;
+	};
+
+	for (int frame = 0; frame < frames; frame++) {
+		glBeginQuery(GL_TIME_ELAPSED, timeQueries[frame % queryCount].get());
+		renderScene();
+		glEndQuery(GL_TIME_ELAPSED);
+		glfwSwapBuffers(myWindow.getWindow());
+		while (nextResult <= frame - (queryCount - 1))
+			readGpuTime(nextResult++);
+	}
+	while (nextResult < frames)
+		readGpuTime(nextResult++);
 
-	//model = glm::rotate(model, glm::radians(-30.0f), glm::vec3(0, 1, 0));
-	//model = glm::scale(model, glm::vec3(0.9f));
+	return totalTime / 1.0e6 / frames;
+}
+
+// average GPU frame time of the basic shader and of the per-fragment one it replaced, in ms
+struct FragmentCost {
+	double perVertex;
+	double perFragment;
+};
+
+// compares the basic shader against the old one that did the eye space setup per fragment
+// the geometry is the same for both, so the difference is the fragment stage cost
+FragmentCost runFragmentCostBenchmark() {
+	const int warmupFrames = 10;
+	const int frames = 200;
+
+	gps::Shader perFragmentShader;
+	perFragmentShader.loadShader(
+		"shaders/basicPerFragment.vert",
+		"shaders/basicPerFragment.frag");
+	gps::MaterialTable::attachShader(perFragmentShader);
+
+	// both shaders are measured with per draw uniforms, so only the shading differs
+	bool wasIndirect = indirectDrawing;
+	indirectDrawing = false;
+	initShaders();
+	initUniforms();
+	initRenderQueue();
 
-	//send teapot model matrix data to shader
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+	FragmentCost cost;
+	measureSceneGpuTime(warmupFrames);
+	cost.perVertex = measureSceneGpuTime(frames);
 
-	//send teapot normal matrix data to shader
-	glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+	std::swap(myBasicShader, perFragmentShader);
+	initUniforms();
+	initRenderQueue();
+	measureSceneGpuTime(warmupFrames);
+	cost.perFragment = measureSceneGpuTime(frames);
 
-	// draw teapot
-	woodLog2.Draw(shader);
+	std::swap(myBasicShader, perFragmentShader);
+	indirectDrawing = wasIndirect;
+	initShaders();
+	initUniforms();
+	initRenderQueue();
+
+	WindowDimensions dimensions = myWindow.getWindowDimensions();
+	printf("Fragment cost (%dx%d, %d frames)\n", dimensions.width, dimensions.height, frames);
+	printf("  per-vertex setup   : %.3f ms\n", cost.perVertex);
+	printf("  per-fragment setup : %.3f ms\n", cost.perFragment);
+	printf("  saved              : %.3f ms (%.1f%%)\n", cost.perFragment - cost.perVertex,
+		100.0 * (cost.perFragment - cost.perVertex) / cost.perFragment);
+	return cost;
 }
 
-void renderScene() {
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
 
-	//render the scene
+// the benchmark flight: one lap around the scene looking slightly down, with a slow nod
+// it only goes through the input, so it flies like a player holding W and turning the mouse
+InputSnapshot scriptedInput(int frame, int frameCount) {
+	InputSnapshot input = InputSnapshot();
+	float lap = (float)frame / frameCount;
+	input.keys[GLFW_KEY_W] = GL_TRUE;
+	input.mouseMoved = true;
+	input.yaw = -90.0f + 360.0f * lap;
+	input.pitch = -10.0f + 5.0f * sinf(glm::radians(360.0f * lap));
+	input.occlusionMode = occlusionMode;
+	input.projection = projection;
+	// fixed simulation time, every frame runs one step whatever the frame took
+	input.time = frame * SIMULATION_STEP;
+	return input;
+}
 
-	// render the teapot
-	renderTeapot(myBasicShader);
+void writePercentiles(FILE* output, const char* name, const gps::FrameTimePercentiles& percentiles) {
+	fprintf(output, "  \"%s\": { \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f, \"mean\": %.4f },\n",
+		name, percentiles.p50, percentiles.p95, percentiles.p99, percentiles.max, percentiles.mean);
+}
 
-	//render Ground 
-	renderGround(myBasicShader);
+// mean render statistics of the frames between two readings of the totals
+void writeRenderStats(FILE* output, const char* name, const gps::RenderStats& before, const gps::RenderStats& after, int frames) {
+	fprintf(output, "  \"%s\": { \"drawCalls\": %.1f, \"triangles\": %.1f, \"vertices\": %.1f, \"programBinds\": %.1f, \"vaoBinds\": %.1f, \"textureBinds\": %.1f, \"uniformBytes\": %.1f, \"bufferBytes\": %.1f, \"textureBytes\": %.1f },\n",
+		name, (double)(after.drawCalls - before.drawCalls) / frames, (double)(after.triangles - before.triangles) / frames,
+		(double)(after.vertices - before.vertices) / frames, (double)(after.programBinds - before.programBinds) / frames,
+		(double)(after.vaoBinds - before.vaoBinds) / frames, (double)(after.textureBinds - before.textureBinds) / frames,
+		(double)(after.uniformBytes - before.uniformBytes) / frames, (double)(after.bufferBytes - before.bufferBytes) / frames,
+		(double)(after.textureBytes - before.textureBytes) / frames);
+}
 
-	//render Axe and Wood Logs
-	if(inAxeRange())
+// renders the scripted flight and writes CPU and GPU frame time percentiles, draw counts, render statistics and load times
+// the CPU time covers simulating, culling and submitting a frame, the GPU time is its timer query
+// the fragment cost comparison runs after the flight, from the last view of the path
+void runSceneBenchmark(int frames, const char* outputPath) {
+	const int warmupFrames = 30;
+	// a frame's GPU time is read a few frames later, so waiting for it doesn't drain the GPU
+	const int queryCount = 4;
+	gps::GLQuery timeQueries[queryCount];
+	for (int i = 0; i < queryCount; i++)
+		timeQueries[i] = gps::GLQuery::create();
+
+	// warm up at the start of the path, half a step early so rounding never runs 0 or 2 steps a frame
+	InputSnapshot input = scriptedInput(0, frames);
+	input.time = -0.5 * SIMULATION_STEP;
 	{
-		animationAxe();
-	}
-	else
-		renderAxe(myBasicShader);
-	if (axeAngle >= 0.4f)
-	{
-		animationWoodLogs();
+		std::lock_guard<std::mutex> lock(inputMutex);
+		latestInput = input;
 	}
-	else {
-		renderWoodLog1(myBasicShader);
-		renderWoodLog2(myBasicShader);
+	for (int i = 0; i < warmupFrames; i++) {
+		renderScene();
+		glfwSwapBuffers(myWindow.getWindow());
 	}
-	
+	glFinish();
+	// everything uploaded before the measured frames, loading and warmup
+	gps::RenderStats loadStats = gps::getTotalRenderStats();
+
+	std::vector<double> cpuTimes, gpuTimes;
+	cpuTimes.reserve(frames);
+	gpuTimes.reserve(frames);
+	double totalDraws = 0.0, totalDrawCalls = 0.0;
+	unsigned int maxDraws = 0, maxDrawCalls = 0;
+	// the steady state should not touch the heap at all
+	size_t totalAllocations = 0, maxAllocations = 0;
+	int nextResult = 1;
+	auto readGpuTime = [&](int frame) {
+		GLuint64 frameTime = 0;
+		glGetQueryObjectui64v(timeQueries[frame % queryCount].get(), GL_QUERY_RESULT, &frameTime);
+		gpuTimes.push_back(frameTime / 1.0e6);
+	};
+
+	for (int frame = 1; frame <= frames; frame++) {
+		{
+			std::lock_guard<std::mutex> lock(inputMutex);
+			latestInput = scriptedInput(frame, frames);
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		size_t allocationsBefore = gps::getAllocationCount();
+		glBeginQuery(GL_TIME_ELAPSED, timeQueries[frame % queryCount].get());
+		renderScene();
+		glEndQuery(GL_TIME_ELAPSED);
+		cpuTimes.push_back(millisecondsSince(start));
+
+		const gps::RenderQueueStats& stats = renderQueue.getStats();
+		totalDraws += stats.draws;
+		totalDrawCalls += stats.drawCalls;
+		if (stats.draws > maxDraws)
+			maxDraws = stats.draws;
+		if (stats.drawCalls > maxDrawCalls)
+			maxDrawCalls = stats.drawCalls;
 
-	//view matrix to hsader
-	view = myCamera.getViewMatrix();
+		glfwSwapBuffers(myWindow.getWindow());
+		size_t allocations = gps::getAllocationCount() - allocationsBefore;
+		totalAllocations += allocations;
+		if (allocations > maxAllocations)
+			maxAllocations = allocations;
+		while (nextResult <= frame - (queryCount - 1))
+			readGpuTime(nextResult++);
+	}
+	while (nextResult <= frames)
+		readGpuTime(nextResult++);
+	gps::RenderStats frameStats = gps::getTotalRenderStats();
+	FragmentCost fragmentCost = runFragmentCostBenchmark();
+
+	FILE* output = fopen(outputPath, "w");
+	if (!output) {
+		std::cerr << "Could not write " << outputPath << std::endl;
+		return;
+	}
 
-	//skybox
-	skyBox.Draw(skyBoxShader, view, projection);
+	WindowDimensions dimensions = myWindow.getWindowDimensions();
+	fprintf(output, "{\n");
+	fprintf(output, "  \"renderer\": \"%s\",\n", (const char*)glGetString(GL_RENDERER));
+	fprintf(output, "  \"version\": \"%s\",\n", (const char*)glGetString(GL_VERSION));
+	fprintf(output, "  \"resolution\": [%d, %d],\n", dimensions.width, dimensions.height);
+	fprintf(output, "  \"frames\": %d,\n", frames);
+	fprintf(output, "  \"warmupFrames\": %d,\n", warmupFrames);
+	fprintf(output, "  \"simulationStep\": %.6f,\n", SIMULATION_STEP);
+	fprintf(output, "  \"loadTimes\": { \"window\": %.2f, \"models\": %.2f, \"scene\": %.2f, \"shaders\": %.2f, \"total\": %.2f },\n",
+		loadTimes.window, loadTimes.models, loadTimes.scene, loadTimes.shaders, loadTimes.total);
+	writePercentiles(output, "cpuFrameTime", gps::computePercentiles(cpuTimes));
+	writePercentiles(output, "gpuFrameTime", gps::computePercentiles(gpuTimes));
+	fprintf(output, "  \"draws\": { \"mean\": %.1f, \"max\": %u },\n", totalDraws / frames, maxDraws);
+	fprintf(output, "  \"drawCalls\": { \"mean\": %.1f, \"max\": %u },\n", totalDrawCalls / frames, maxDrawCalls);
+	writeRenderStats(output, "renderStats", loadStats, frameStats, frames);
+	fprintf(output, "  \"fragmentCost\": { \"perVertex\": %.4f, \"perFragment\": %.4f },\n", fragmentCost.perVertex, fragmentCost.perFragment);
+	if (gps::isAllocationTrackingEnabled())
+		fprintf(output, "  \"allocations\": { \"mean\": %.2f, \"max\": %u, \"total\": %u },\n",
+			(double)totalAllocations / frames, (unsigned int)maxAllocations, (unsigned int)totalAllocations);
+	fprintf(output, "  \"uploadedBeforeFrames\": { \"bufferBytes\": %llu, \"textureBytes\": %llu },\n",
+		loadStats.bufferBytes, loadStats.textureBytes);
+	fprintf(output, "  \"gpuMemory\": { \"total\": %llu", (unsigned long long)gps::getGpuMemoryTotal());
+	for (int category = 0; category < gps::GPU_MEMORY_CATEGORY_COUNT; category++)
+		fprintf(output, ", \"%s\": %llu", gps::getGpuMemoryCategoryName((gps::GpuMemoryCategory)category),
+			(unsigned long long)gps::getGpuMemoryTotal((gps::GpuMemoryCategory)category));
+	fprintf(output, " }\n");
+	fprintf(output, "}\n");
+	fclose(output);
+	printf("Benchmark: %d frames written to %s\n", frames, outputPath);
 }
 
 void cleanup() {
+	if (cameraRecordFile) {
+		// the end of the flight, whatever step it stopped on
+		cameraRecording.addKeyframe(simulationSteps * SIMULATION_STEP, currentState.cameraPosition, currentState.cameraFront);
+		cameraRecording.save(cameraRecordFile);
+	}
+
+	if (gpuProfileFile) {
+		size_t length = strlen(gpuProfileFile);
+		if (length > 5 && strcmp(gpuProfileFile + length - 5, ".json") == 0)
+			gpuProfiler.writeJson(gpuProfileFile);
+		else
+			gpuProfiler.writeCsv(gpuProfileFile);
+	}
+
+	gps::printDebugMessageSummary();
+
+	// GL objects are released by their owners, so drop them while the context still exists
+	teapot = gps::Model3D();
+	ground = gps::Model3D();
+	axe = gps::Model3D();
+	woodLog1 = gps::Model3D();
+	woodLog2 = gps::Model3D();
+	geometryArena = gps::GeometryArena();
+	renderQueue = gps::RenderQueue();
+	skyBox = gps::SkyBox();
+	materialTable = gps::MaterialTable();
+	myBasicShader = gps::Shader();
+	lightShader = gps::Shader();
+	depthMapShader = gps::Shader();
+	skyBoxShader = gps::Shader();
+	occlusionQueries = gps::OcclusionQueries();
+	gpuProfiler = gps::GpuProfiler();
+	gpuCuller = gps::GpuCuller();
+	instancedShader = gps::Shader();
+	jobSystem.stop();
+	// every thread is done recording now
+	if (traceFile)
+		gps::writeChromeTrace(traceFile);
+	if (gps::isAllocationTrackingEnabled())
+		gps::printAllocationReport();
+
     myWindow.Delete();
-    //cleanup code for your own data
 }
 
 int main(int argc, const char * argv[]) {
+	gps::setProfileThreadName("main");
+	bool fragmentBenchmark = false;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--benchmark") == 0) {
+			benchmarkFrames = -1;
+			if (i + 1 < argc && argv[i + 1][0] >= '0' && argv[i + 1][0] <= '9')
+				benchmarkFrames = atoi(argv[++i]);
+		}
+		if (strcmp(argv[i], "--benchmark-out") == 0 && i + 1 < argc)
+			benchmarkOutput = argv[++i];
+		if (strcmp(argv[i], "--bench-fragment") == 0)
+			fragmentBenchmark = true;
+		if (strcmp(argv[i], "--hitch-budget") == 0 && i + 1 < argc)
+			flightRecorder.setBudget((float)atof(argv[++i]));
+		if (strcmp(argv[i], "--hitch-prefix") == 0 && i + 1 < argc)
+			flightRecorder.setOutputPrefix(argv[++i]);
+		if (strcmp(argv[i], "--vram-budget") == 0 && i + 1 < argc)
+			gps::setGpuMemoryBudget((size_t)(atof(argv[++i]) * 1024.0 * 1024.0));
+		if (strcmp(argv[i], "--gl-debug") == 0 && i + 1 < argc)
+			debugSeverity = gps::parseDebugSeverity(argv[++i]);
+		if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+			traceFile = argv[++i];
+		if (strcmp(argv[i], "--gpu-profile") == 0 && i + 1 < argc)
+			gpuProfileFile = argv[++i];
+		if (strcmp(argv[i], "--record-camera") == 0 && i + 1 < argc)
+			cameraRecordFile = argv[++i];
+		if (strcmp(argv[i], "--replay-camera") == 0 && i + 1 < argc) {
+			replayingCamera = cameraReplay.load(argv[++i]);
+			if (!replayingCamera)
+				return EXIT_FAILURE;
+		}
+		if (strcmp(argv[i], "--scatter") == 0 && i + 1 < argc)
+			scatterCount = atoi(argv[++i]);
+		if (strcmp(argv[i], "--pipeline") == 0)
+			pipelined = true;
+		if (strcmp(argv[i], "--no-vsync") == 0)
+			vsync = false;
+		if (strcmp(argv[i], "--fps-limit") == 0 && i + 1 < argc)
+			fpsLimit = atoi(argv[++i]);
+		// CPU microbenchmarks don't need a window
+		if (strcmp(argv[i], "--bench-culling") == 0) {
+			gps::runCullingBenchmark();
+			return EXIT_SUCCESS;
+		}
+		if (strcmp(argv[i], "--bench-occlusion") == 0) {
+			gps::runOcclusionBenchmark();
+			return EXIT_SUCCESS;
+		}
+		if (strcmp(argv[i], "--bench-jobs") == 0) {
+			gps::runJobBenchmark();
+			return EXIT_SUCCESS;
+		}
+	}
+	// a benchmark of the default length flies a whole replayed path
+	if (benchmarkFrames < 0)
+		benchmarkFrames = replayingCamera ? (int)(cameraReplay.getDuration() / SIMULATION_STEP) + 1 : 600;
+
 	//_getch();
+	std::chrono::steady_clock::time_point loadStart = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point phaseStart = loadStart;
     try {
         initOpenGLWindow();
     } catch (const std::exception& e) {
@@ -626,30 +1546,115 @@ int main(int argc, const char * argv[]) {
     }
 	//_getch();
     initOpenGLState();
+	if (!vsync)
+		glfwSwapInterval(0);
+	indirectDrawing = GLEW_VERSION_4_3 != 0;
+	loadTimes.window = millisecondsSince(phaseStart);
+	phaseStart = std::chrono::steady_clock::now();
 	initModels();
+	loadTimes.models = millisecondsSince(phaseStart);
+	phaseStart = std::chrono::steady_clock::now();
+	initSceneGraph();
+	initSceneEntries();
+	jobSystem.start(0);
+#if GPS_PROFILE
+	// every job is a zone on the thread that ran it
+	jobSystem.setProfileHooks(
+		[](const char* name, unsigned int, void*) { gps::beginProfileZone(name); },
+		[](const char*, unsigned int, void*) { gps::endProfileZone(); }, NULL);
+#endif
+	occlusionCuller.setJobSystem(&jobSystem);
+	initOccluders();
+	loadTimes.scene = millisecondsSince(phaseStart);
+	phaseStart = std::chrono::steady_clock::now();
 	initShaders();
+	occlusionQueries.init();
 	initUniforms();
+	initScatter();
 
 	//skybox
 	initSkyBoxFaces2();
 	initSkyBoxShader();
+	initRenderQueue();
+	gpuProfiler.init();
+	loadTimes.shaders = millisecondsSince(phaseStart);
+	loadTimes.total = millisecondsSince(loadStart);
+	if (gps::isGpuMemoryOverBudget())
+		gps::printGpuMemoryReport();
+	if (gps::isAllocationTrackingEnabled())
+		gps::printAllocationReport();
 
     setWindowCallbacks();
+	publishInput();
+
+	if (fragmentBenchmark) {
+		runFragmentCostBenchmark();
+		cleanup();
+		return EXIT_SUCCESS;
+	}
+
+	if (benchmarkFrames > 0) {
+		// frame times, not the refresh rate
+		glfwSwapInterval(0);
+		runSceneBenchmark(benchmarkFrames, benchmarkOutput);
+		cleanup();
+		return EXIT_SUCCESS;
+	}
 
 	//glfwSetInputMode(myWindow.getWindow(), GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
 	glCheckError();
 	// application loop
+	// the main thread renders; the simulation runs here too unless it has its own thread
+	// latency is measured from the input a frame was simulated with to its swap
+	if (pipelined)
+		simulationThread = std::thread(simulationLoop);
+
+	std::chrono::steady_clock::time_point nextFrame = std::chrono::steady_clock::now();
 	int asd = 0;
 	while (!glfwWindowShouldClose(myWindow.getWindow())) {
-        processMovement();
-	    renderScene();
+		gps::FlightFrame flight;
+		flight.start = glfwGetTime();
+		size_t allocationsBefore = gps::getAllocationCount();
+		if (!pipelined) {
+			int simulated = framePipeline.acquireForSimulation();
+			simulateFrame(framePackets[simulated]);
+			framePipeline.publish(simulated, framePackets[simulated].inputTime);
+		}
+
+		int rendered = framePipeline.acquireForRender();
+		flight.renderStart = glfwGetTime();
+	    renderFrame(framePackets[rendered]);
+		flight.renderTime = (float)((glfwGetTime() - flight.renderStart) * 1000.0);
+		updateStatsTitle();
+		recordFlightDetails(flight, framePackets[rendered]);
 		
 		glfwPollEvents();
+		publishInput();
 		glfwSwapBuffers(myWindow.getWindow());
+		framePipeline.release(rendered, glfwGetTime());
 		glCheckError();
+
+		// frame limiter, a late frame moves the schedule instead of rushing the next ones
+		if (fpsLimit > 0) {
+			nextFrame += std::chrono::microseconds(1000000 / fpsLimit);
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			if (nextFrame > now)
+				std::this_thread::sleep_until(nextFrame);
+			else
+				nextFrame = now;
+		}
+
+		flight.frameTime = (float)((glfwGetTime() - flight.start) * 1000.0);
+		frameAllocations = (unsigned int)(gps::getAllocationCount() - allocationsBefore);
+		flight.allocations = frameAllocations;
+		flightRecorder.record(flight);
 	}
 
+	framePipeline.stop();
+	if (simulationThread.joinable())
+		simulationThread.join();
+
 	cleanup();
 
     return EXIT_SUCCESS;
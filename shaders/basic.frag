@@ -1,60 +1,60 @@
 #version 410 core
 
-in vec3 fPosition;
-in vec3 fNormal;
+in vec3 fPosEye;
+in vec3 fNormalEye;
 in vec2 fTexCoords;
-in vec4 fragPosEye;
-in vec3 normal;
-in vec2 fragTexCoords;
+flat in uint fMaterialId;
 
 out vec4 fColor;
 
-//matrices
-uniform mat4 model;
-uniform mat4 view;
-uniform mat3 normalMatrix;
-uniform mat3 lightDirMatrix;
 //lighting
-uniform vec3 lightDir;
+uniform vec3 lightDirEye; //normalized, eye space - updated once per frame
 uniform vec3 lightColor;
 // textures
 uniform sampler2D diffuseTexture;
 uniform sampler2D specularTexture;
 // fog
 uniform int fogEnable;
-uniform int fogEnableLoc;
-uniform int fogDensity;
+
+//materials of all the loaded models, see MaterialTable
+struct Material
+{
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular; //a = shininess
+};
+
+layout(std140) uniform MaterialBlock
+{
+    Material materials[256];
+};
 
 //components
 vec3 ambient;
 float ambientStrength = 0.2f;
 vec3 diffuse;
 vec3 specular;
-float specularStrength = 0.5f;
 
 
 vec3 computeDirLight()
 {
-    //compute eye space coordinates
-    vec4 fPosEye = view * model * vec4(fPosition, 1.0f);
-    vec3 normalEye = normalize(normalMatrix * fNormal);
-
-    //normalize light direction
-    vec3 lightDirN = vec3(normalize(view * vec4(lightDir, 0.0f)));
+    vec3 normalEye = normalize(fNormalEye);
 
     //compute view direction (in eye coordinates, the viewer is situated at the origin
-    vec3 viewDir = normalize(- fPosEye.xyz);
+    vec3 viewDir = normalize(- fPosEye);
+
+    Material material = materials[fMaterialId];
 
     //compute ambient light
-    ambient = ambientStrength * lightColor;
+    ambient = ambientStrength * material.ambient.rgb * lightColor;
 
     //compute diffuse light
-    diffuse = max(dot(normalEye, lightDirN), 0.0f) * lightColor;
+    diffuse = max(dot(normalEye, lightDirEye), 0.0f) * material.diffuse.rgb * lightColor;
 
     //compute specular light
-    vec3 reflectDir = reflect(-lightDirN, normalEye);
-    float specCoeff = pow(max(dot(viewDir, reflectDir), 0.0f), 32);
-    specular = specularStrength * specCoeff * lightColor;
+    vec3 reflectDir = reflect(-lightDirEye, normalEye);
+    float specCoeff = pow(max(dot(viewDir, reflectDir), 0.0f), max(material.specular.a, 1.0f));
+    specular = material.specular.rgb * specCoeff * lightColor;
 
 	return (ambient + diffuse + specular);
 }
@@ -62,7 +62,8 @@ vec3 computeDirLight()
 float computeFog()
 {
  float fogDensity = 0.2f;
- float fragmentDistance = length(fPosition);
+ //distance from the viewer, in eye space
+ float fragmentDistance = length(fPosEye);
  float fogFactor = exp(-pow(fragmentDistance * fogDensity, 2));
  
  return clamp(fogFactor, 0.0f, 1.0f);
@@ -3,19 +3,25 @@
 layout(location=0) in vec3 vPosition;
 layout(location=1) in vec3 vNormal;
 layout(location=2) in vec2 vTexCoords;
+layout(location=3) in uint vMaterialId;
 
-out vec3 fPosition;
-out vec3 fNormal;
+out vec3 fPosEye;
+out vec3 fNormalEye;
 out vec2 fTexCoords;
+flat out uint fMaterialId;
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+uniform mat3 normalMatrix;
 
 void main() 
 {
-	gl_Position = projection * view * model * vec4(vPosition, 1.0f);
-	fPosition = vPosition;
-	fNormal = vNormal;
+	//compute eye space coordinates once per vertex, they are interpolated for the fragment stage
+	vec4 posEye = view * model * vec4(vPosition, 1.0f);
+	fPosEye = posEye.xyz;
+	fNormalEye = normalMatrix * vNormal;
 	fTexCoords = vTexCoords;
+	fMaterialId = vMaterialId;
+	gl_Position = projection * posEye;
 }
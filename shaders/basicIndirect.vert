@@ -0,0 +1,38 @@
+#version 430 core
+
+layout(location=0) in vec3 vPosition;
+layout(location=1) in vec3 vNormal;
+layout(location=2) in vec2 vTexCoords;
+// base instance of the draw command, the index of its DrawData
+layout(location=4) in uint vDrawIndex;
+
+out vec3 fPosEye;
+out vec3 fNormalEye;
+out vec2 fTexCoords;
+flat out uint fMaterialId;
+
+struct DrawData {
+	mat4 model;
+	mat4 normalMatrix;
+	uint materialId;
+};
+
+layout(std430, binding = 1) readonly buffer DrawDataBlock {
+	DrawData draws[];
+};
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main() 
+{
+	DrawData draw = draws[vDrawIndex];
+
+	//same as basic.vert, with the transform and material of the draw from the buffer
+	vec4 posEye = view * draw.model * vec4(vPosition, 1.0f);
+	fPosEye = posEye.xyz;
+	fNormalEye = mat3(draw.normalMatrix) * vNormal;
+	fTexCoords = vTexCoords;
+	fMaterialId = draw.materialId;
+	gl_Position = projection * posEye;
+}
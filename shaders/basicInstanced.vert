@@ -0,0 +1,65 @@
+#version 430 core
+#extension GL_ARB_shader_draw_parameters : require
+
+layout(location=0) in vec3 vPosition;
+layout(location=1) in vec3 vNormal;
+layout(location=2) in vec2 vTexCoords;
+
+out vec3 fPosEye;
+out vec3 fNormalEye;
+out vec2 fTexCoords;
+flat out uint fMaterialId;
+
+// layouts mirror GpuCulling.hpp
+struct Instance {
+	mat4 model;
+	mat4 normalMatrix;
+	uint prototype;
+};
+
+struct DrawSlot {
+	uint count;
+	uint firstIndex;
+	int baseVertex;
+	uint materialId;
+	uint instanceOffset;
+	uint commandBase;
+	uint indexInBucket;
+	uint bucket;
+};
+
+layout(std430, binding = 0) readonly buffer InstanceBlock {
+	Instance instances[];
+};
+
+layout(std430, binding = 2) readonly buffer SlotBlock {
+	DrawSlot slots[];
+};
+
+layout(std430, binding = 4) readonly buffer VisibleBlock {
+	uint visibleInstances[];
+};
+
+layout(std430, binding = 7) readonly buffer CommandSlotBlock {
+	uint commandSlots[];
+};
+
+uniform mat4 view;
+uniform mat4 projection;
+// first command of the multi draw, gl_DrawIDARB restarts at 0 for every call
+uniform uint drawBase;
+
+void main() 
+{
+	//base instance of the command is where the visible list of its mesh starts
+	Instance instance = instances[visibleInstances[gl_BaseInstanceARB + gl_InstanceID]];
+	DrawSlot slot = slots[commandSlots[drawBase + gl_DrawIDARB]];
+
+	//same as basic.vert, with the transform of the instance
+	vec4 posEye = view * instance.model * vec4(vPosition, 1.0f);
+	fPosEye = posEye.xyz;
+	fNormalEye = mat3(view) * mat3(instance.normalMatrix) * vNormal;
+	fTexCoords = vTexCoords;
+	fMaterialId = slot.materialId;
+	gl_Position = projection * posEye;
+}
@@ -0,0 +1,102 @@
+#version 410 core
+
+in vec3 fPosition;
+in vec3 fNormal;
+in vec2 fTexCoords;
+in vec4 fragPosEye;
+in vec3 normal;
+in vec2 fragTexCoords;
+flat in uint fMaterialId;
+
+out vec4 fColor;
+
+//matrices
+uniform mat4 model;
+uniform mat4 view;
+uniform mat3 normalMatrix;
+uniform mat3 lightDirMatrix;
+//lighting
+uniform vec3 lightDir;
+uniform vec3 lightColor;
+// textures
+uniform sampler2D diffuseTexture;
+uniform sampler2D specularTexture;
+// fog
+uniform int fogEnable;
+uniform int fogEnableLoc;
+uniform int fogDensity;
+
+//materials of all the loaded models, see MaterialTable
+struct Material
+{
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular; //a = shininess
+};
+
+layout(std140) uniform MaterialBlock
+{
+    Material materials[256];
+};
+
+//components
+vec3 ambient;
+float ambientStrength = 0.2f;
+vec3 diffuse;
+vec3 specular;
+
+
+vec3 computeDirLight()
+{
+    //compute eye space coordinates
+    vec4 fPosEye = view * model * vec4(fPosition, 1.0f);
+    vec3 normalEye = normalize(normalMatrix * fNormal);
+
+    //normalize light direction
+    vec3 lightDirN = vec3(normalize(view * vec4(lightDir, 0.0f)));
+
+    //compute view direction (in eye coordinates, the viewer is situated at the origin
+    vec3 viewDir = normalize(- fPosEye.xyz);
+
+    Material material = materials[fMaterialId];
+
+    //compute ambient light
+    ambient = ambientStrength * material.ambient.rgb * lightColor;
+
+    //compute diffuse light
+    diffuse = max(dot(normalEye, lightDirN), 0.0f) * material.diffuse.rgb * lightColor;
+
+    //compute specular light
+    vec3 reflectDir = reflect(-lightDirN, normalEye);
+    float specCoeff = pow(max(dot(viewDir, reflectDir), 0.0f), max(material.specular.a, 1.0f));
+    specular = material.specular.rgb * specCoeff * lightColor;
+
+	return (ambient + diffuse + specular);
+}
+
+float computeFog()
+{
+ float fogDensity = 0.2f;
+ float fragmentDistance = length(fPosition);
+ float fogFactor = exp(-pow(fragmentDistance * fogDensity, 2));
+ 
+ return clamp(fogFactor, 0.0f, 1.0f);
+}
+
+void main() 
+{
+    computeDirLight();
+
+    //compute final vertex color
+    vec3 color = min((ambient + diffuse) * texture(diffuseTexture, fTexCoords).rgb + specular * texture(specularTexture, fTexCoords).rgb, 1.0f);
+
+	//fog
+    float fogFactor = computeFog();
+    vec3 fogColor = vec3(0.5f, 0.5f, 0.5f);
+    
+    if (fogEnable == 1){
+		fColor = vec4( fogColor * (1 - fogFactor) + color * fogFactor, 1.0f);
+    }
+	else
+		fColor = vec4(color, 1.0f);
+}
@@ -0,0 +1,9 @@
+#version 410 core
+
+out vec4 fColor;
+
+// only used inside occlusion queries, color writes are off
+void main()
+{
+    fColor = vec4(1.0);
+}
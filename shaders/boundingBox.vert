@@ -0,0 +1,13 @@
+#version 410 core
+
+layout(location = 0) in vec3 vPosition;
+
+// world space box, vPosition is a corner of the unit cube
+uniform vec3 center;
+uniform vec3 extent;
+uniform mat4 viewProjection;
+
+void main()
+{
+    gl_Position = viewProjection * vec4(center + extent * vPosition, 1.0);
+}
@@ -0,0 +1,16 @@
+#version 410 core
+
+// position in pixels from the top left corner
+layout(location = 0) in vec2 vPosition;
+layout(location = 1) in vec3 vColor;
+
+uniform vec2 viewportSize;
+
+out vec3 fColor;
+
+void main()
+{
+    vec2 ndc = vPosition / viewportSize * 2.0 - 1.0;
+    gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+    fColor = vColor;
+}
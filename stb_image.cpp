@@ -1,2 +1,8 @@
+#include "AllocationTracker.hpp"
+
+// decoded images are counted with the allocations of the rest of the program
+#define STBI_MALLOC(size) gps::trackedMalloc(size)
+#define STBI_REALLOC(block, size) gps::trackedRealloc(block, size)
+#define STBI_FREE(block) gps::trackedFree(block)
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
\ No newline at end of file